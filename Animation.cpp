@@ -0,0 +1,156 @@
+#include "Animation.h"
+#include "ofApp.h"
+
+// Point on the Catmull-Rom spline through p1 at u = 0 and p2 at u = 1, with p0 and p3 the keys on either side
+//
+template<class T> static T catmullRom(const T &p0, const T &p1, const T &p2, const T &p3, float u) {
+	float u2 = u * u, u3 = u2 * u;
+	return 0.5f * ((2.0f * p1) + (p2 - p0) * u + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * u3);
+}
+
+// Position, plus rotation and scale for the mesh types that have them
+//
+ObjectPose Animation::getPose(SceneObject *obj) {
+	ObjectPose pose;
+	pose.position = obj->position;
+	if (Mesh *mesh = dynamic_cast<Mesh *>(obj)) {
+		pose.rotation = mesh->rotation;
+		pose.scale = mesh->scale;
+	}
+	else if (OutOfCoreMesh *mesh = dynamic_cast<OutOfCoreMesh *>(obj)) {
+		pose.rotation = mesh->rotation;
+		pose.scale = mesh->scale;
+	}
+	return pose;
+}
+
+// The other half of getPose()
+//
+void Animation::setPose(SceneObject *obj, const ObjectPose &pose) {
+	obj->position = pose.position;
+	if (Mesh *mesh = dynamic_cast<Mesh *>(obj)) {
+		mesh->rotation = pose.rotation;
+		mesh->scale = pose.scale;
+	}
+	else if (OutOfCoreMesh *mesh = dynamic_cast<OutOfCoreMesh *>(obj)) {
+		mesh->rotation = pose.rotation;
+		mesh->scale = pose.scale;
+	}
+}
+
+// The render camera and every object in the scene as they are now
+//
+Keyframe Animation::capture(ofApp *app) {
+	Keyframe key;
+	key.camPosition = app->renderCam.position;
+	key.viewPosition = app->renderCam.view.position;
+	key.viewMin = app->renderCam.view.min;
+	key.viewMax = app->renderCam.view.max;
+	for (SceneObject *obj : app->scene) key.poses[obj] = getPose(obj);
+	return key;
+}
+
+// Put the camera and objects where key has them, leaving objects that are already there alone
+//
+void Animation::setPoses(ofApp *app, const Keyframe &key) {
+	app->renderCam.position = key.camPosition;
+	app->renderCam.view.position = key.viewPosition;
+	app->renderCam.view.min = key.viewMin;
+	app->renderCam.view.max = key.viewMax;
+	for (const auto &entry : key.poses) {
+		if (!(getPose(entry.first) == entry.second)) setPose(entry.first, entry.second);
+	}
+}
+
+// Objects added since the earlier keyframes get their current pose in those too, so every keyframe has every object
+//
+void Animation::addKeyframe(ofApp *app) {
+	Keyframe key = capture(app);
+	for (Keyframe &earlier : keyframes) {
+		for (const auto &entry : key.poses) earlier.poses.insert(entry);
+	}
+	keyframes.push_back(key);
+	cout << "keyframe " << keyframes.size() << " added" << endl;
+}
+
+// Drop an object that is being deleted from every keyframe
+//
+void Animation::forget(SceneObject *obj) {
+	for (Keyframe &key : keyframes) key.poses.erase(obj);
+}
+
+// Pose everything at t from 0 to 1 across the keyframes, along Catmull-Rom splines through them
+//
+void Animation::apply(ofApp *app, float t) {
+	int n = keyframes.size();
+	if (n == 0) return;
+	if (n == 1) {
+		setPoses(app, keyframes[0]);
+		return;
+	}
+	float s = ofClamp(t, 0, 1) * (n - 1);
+	int i = min((int)s, n - 2);
+	float u = s - i;
+	const Keyframe &k0 = keyframes[max(i - 1, 0)];
+	const Keyframe &k1 = keyframes[i];
+	const Keyframe &k2 = keyframes[i + 1];
+	const Keyframe &k3 = keyframes[min(i + 2, n - 1)];
+
+	Keyframe key;
+	key.camPosition = catmullRom(k0.camPosition, k1.camPosition, k2.camPosition, k3.camPosition, u);
+	key.viewPosition = catmullRom(k0.viewPosition, k1.viewPosition, k2.viewPosition, k3.viewPosition, u);
+	key.viewMin = catmullRom(k0.viewMin, k1.viewMin, k2.viewMin, k3.viewMin, u);
+	key.viewMax = catmullRom(k0.viewMax, k1.viewMax, k2.viewMax, k3.viewMax, u);
+	for (const auto &entry : k1.poses) {
+		auto poseIn = [&entry](const Keyframe &k) -> const ObjectPose & {
+			auto found = k.poses.find(entry.first);
+			return (found != k.poses.end()) ? found->second : entry.second;
+		};
+		const ObjectPose &p0 = poseIn(k0), &p1 = entry.second, &p2 = poseIn(k2), &p3 = poseIn(k3);
+		ObjectPose pose;
+		pose.position = catmullRom(p0.position, p1.position, p2.position, p3.position, u);
+		pose.rotation = catmullRom(p0.rotation, p1.rotation, p2.rotation, p3.rotation, u);
+		pose.scale = max(0.01f, catmullRom(p0.scale, p1.scale, p2.scale, p3.scale, u));
+		key.poses[entry.first] = pose;
+	}
+	setPoses(app, key);
+}
+
+// Trace one frame while the image writer encodes the ones before it. The scene itself is only changed between traces,
+// since the render threads read it the whole time they run.
+//
+bool Animation::render(ofApp *app, int frames, bool aa, string directory) {
+	if (keyframes.size() < 2 || frames < 2) {
+		cout << "an animation needs at least two keyframes (press f to add one) and two frames" << endl;
+		return false;
+	}
+	TRACE_SCOPE("render animation", "render");
+	ofDirectory::createDirectory(directory, true, true);
+	Keyframe before = capture(app);
+
+	const string &outputFile = app->outputFile;
+	string ext = ofFilePath::getFileExt(outputFile);		// frames are saved in the output file's format
+	if (ext.empty()) ext = "png";
+	app->writer.pngCompression = app->pngCompression;
+	bool finished = true;
+	int rendered = 0;
+	float traceSeconds = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int f = 0; f < frames && finished; f++) {
+		apply(app, (float)f / (frames - 1));
+		auto traceStart = std::chrono::steady_clock::now();
+		finished = app->renderImage(aa, true);
+		traceSeconds += std::chrono::duration<float>(std::chrono::steady_clock::now() - traceStart).count();
+
+		app->writer.write(app->image.getPixels(), directory + "/frame_" + ofToString(f, 4, '0') + "." + ext);
+		rendered++;
+		cout << "frame " << rendered << " of " << frames << endl;
+	}
+	app->writer.waitIdle();
+	setPoses(app, before);
+
+	float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	cout << rendered << " frames saved in bin/data/" << directory << " in " << seconds << "s: " << 3600 * rendered / seconds
+		<< " frames/hour, against " << 3600 * rendered / traceSeconds << " for the tracing alone" << endl;
+	return finished;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Rendering a sequence of frames from keyframes (press f to add a keyframe, a to render the sequence).
+// A keyframe holds the render camera and the position of every object, and the rotation and scale of meshes.
+// The render camera always looks down the z axis through a view window fixed in world space, so a keyframe records the
+// camera's position and that window; moving the camera in x or y without moving the window skews the view, just as
+// it does in a single render, and the camera can't turn.
+// Frames are spread evenly across the keyframes, and in between everything moves along a Catmull-Rom spline through
+// them, so a turntable needs only a few keyframes of a mesh's rotation. Only objects whose pose changed since the
+// last frame are touched, so what's cached for the rest carries over; a mesh's BVH and levels of detail are in its own
+// space and are never rebuilt for a move. Frames go to the image writer in the output file's format and are encoded
+// while the next ones are set up and traced, so saving adds next to nothing to the time per frame.
+
+class ofApp;
+class SceneObject;
+
+//  Where an object is; rotation and scale are only used for meshes
+//
+struct ObjectPose {
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	glm::vec3 rotation = glm::vec3(0, 0, 0);
+	float scale = 1;
+
+	bool operator==(const ObjectPose &other) const {
+		return position == other.position && rotation == other.rotation && scale == other.scale;
+	}
+};
+
+//  The render camera, its view window, and every object's pose at one moment
+//
+struct Keyframe {
+	glm::vec3 camPosition, viewPosition;
+	glm::vec2 viewMin, viewMax;
+	map<SceneObject *, ObjectPose> poses;
+};
+
+//  Keyframes, and the sequence renderer
+//
+class Animation {
+public:
+	void addKeyframe(ofApp *app);
+	void clear() { keyframes.clear(); }
+	void forget(SceneObject *obj);		// an object leaving the scene
+	int getNumKeyframes() { return keyframes.size(); }
+
+	// Move the camera and objects to where they are at t, from 0 at the first keyframe to 1 at the last
+	void apply(ofApp *app, float t);
+
+	// Render frames images of imageWidth x imageHeight into directory (in bin/data) as frame_0000.png and so on, in the
+	// output file's format, then put the camera and objects back. False if there were fewer than two keyframes or a
+	// frame didn't finish.
+	bool render(ofApp *app, int frames, bool aa, string directory);
+
+private:
+	Keyframe capture(ofApp *app);
+	void setPoses(ofApp *app, const Keyframe &key);
+	static ObjectPose getPose(SceneObject *obj);
+	static void setPose(SceneObject *obj, const ObjectPose &pose);
+
+	vector<Keyframe> keyframes;
+};
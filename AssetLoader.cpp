@@ -0,0 +1,85 @@
+#include "AssetLoader.h"
+#include "Tracer.h"
+
+AssetLoader::~AssetLoader() {
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		stopping = true;
+		queued.clear();		// jobs that haven't started are dropped; running ones finish first
+	}
+	jobReady.notify_all();
+	for (std::thread &t : threads) t.join();
+}
+
+void AssetLoader::start(int numThreads) {
+	for (int i = 0; i < numThreads; i++) threads.push_back(std::thread(&AssetLoader::workerLoop, this, i));
+}
+
+void AssetLoader::add(string name, glm::vec3 lo, glm::vec3 hi, std::function<bool()> work, std::function<void(bool)> finish) {
+	shared_ptr<Job> job = make_shared<Job>();
+	job->name = name;
+	job->lo = lo;
+	job->hi = hi;
+	job->work = work;
+	job->finish = finish;
+	job->startTime = ofGetElapsedTimeMillis();
+	pending.push_back(job);
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		queued.push_back(job);
+	}
+	jobReady.notify_one();
+}
+
+// Take jobs off the queue until the loader is destroyed
+//
+void AssetLoader::workerLoop(int index) {
+	Tracer::setThreadName("loader thread " + ofToString(index));
+	while (true) {
+		shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(jobsMutex);
+			jobReady.wait(lock, [this] { return stopping || !queued.empty(); });
+			if (stopping) return;
+			job = queued.front();
+			queued.pop_front();
+		}
+
+		TRACE_SCOPE_ARGS("load asset", "load", "\"file\":\"" + ofFilePath::getFileName(job->name) + "\"");
+		job->succeeded = job->work();
+
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		done.push_back(job);
+	}
+}
+
+void AssetLoader::collect() {
+	vector<shared_ptr<Job>> finished;
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		finished.swap(done);
+	}
+	for (shared_ptr<Job> &job : finished) {
+		job->finish(job->succeeded);
+		cout << (job->succeeded ? "loaded " : "failed to load ") << job->name << " in " << (ofGetElapsedTimeMillis() - job->startTime) / 1000.0 << "s" << endl;
+		pending.erase(std::find(pending.begin(), pending.end(), job));
+	}
+}
+
+// A wireframe box for each asset still loading
+//
+void AssetLoader::drawPlaceholders() {
+	ofNoFill();
+	ofSetColor(ofColor::gray);
+	for (shared_ptr<Job> &job : pending) {
+		if (job->lo == job->hi) continue;
+		glm::vec3 size = job->hi - job->lo;
+		ofDrawBox((job->lo + job->hi) / 2, size.x, size.y, size.z);
+	}
+	ofSetColor(ofColor::white);
+	ofFill();
+}
+
+int AssetLoader::getNumPending() {
+	return pending.size();
+}
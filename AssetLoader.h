@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Background loading of meshes and textures.
+// Dropped .obj files and the startup textures are parsed and preprocessed (normals, BVH, levels of detail, mip
+// chains) by a pool of loader threads, so the window keeps drawing while they load and many files load at once.
+// Each job's work runs on a loader thread and must only touch objects that aren't in the scene yet; its finish step
+// runs on the main thread from update(), which is where loaded objects are added to the scene. Until then each job
+// is drawn as a placeholder box where it will appear.
+
+//  Pool of loader threads and the jobs waiting for them
+//
+class AssetLoader {
+public:
+	~AssetLoader();
+
+	void start(int numThreads);
+
+	// Queue a job: work() runs on a loader thread and returns whether it succeeded; finish(succeeded) runs later on
+	// the main thread. lo and hi are the placeholder box drawn in the meantime.
+	void add(string name, glm::vec3 lo, glm::vec3 hi, std::function<bool()> work, std::function<void(bool)> finish);
+
+	void collect();					// call from the main thread: finish every job that's done
+	void drawPlaceholders();
+	int getNumPending();
+
+private:
+	struct Job {
+		string name;
+		glm::vec3 lo, hi;
+		std::function<bool()> work;
+		std::function<void(bool)> finish;
+		bool succeeded = false;
+		uint64_t startTime;		// ofGetElapsedTimeMillis() when it was queued
+	};
+
+	void workerLoop(int index);
+
+	vector<std::thread> threads;
+	std::mutex jobsMutex;
+	std::condition_variable jobReady;
+	std::deque<shared_ptr<Job>> queued;
+	vector<shared_ptr<Job>> pending;	// queued or running, for placeholders; only the main thread touches this
+	vector<shared_ptr<Job>> done;
+	bool stopping = false;
+};
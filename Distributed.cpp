@@ -0,0 +1,779 @@
+#ifdef _WIN32
+#include <winsock2.h>		// before anything pulls in windows.h
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <csignal>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Distributed.h"
+#include "ofApp.h"
+
+#ifdef _WIN32
+typedef SOCKET NativeSocket;
+static const NativeSocket invalidSocket = INVALID_SOCKET;
+static void closeSocket(NativeSocket s) { closesocket(s); }
+#else
+typedef int NativeSocket;
+static const NativeSocket invalidSocket = -1;
+static void closeSocket(NativeSocket s) { ::close(s); }
+#endif
+
+// Winsock has to be started before use; elsewhere, a write to a closed connection should fail rather than kill the process
+//
+static bool startSockets() {
+#ifdef _WIN32
+	static bool started = [] {
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+	return started;
+#else
+	static bool started = [] {
+		signal(SIGPIPE, SIG_IGN);
+		return true;
+	}();
+	return started;
+#endif
+}
+
+// Tiles and results are small messages in a back and forth, so don't let them wait to be batched
+//
+static void setNoDelay(NativeSocket s) {
+	int one = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+}
+
+// Try every address host resolves to until one takes the connection
+//
+bool Socket::connect(const string &host, int port) {
+	close();
+	if (!startSockets()) return false;
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo *found = NULL;
+	if (getaddrinfo(host.c_str(), ofToString(port).c_str(), &hints, &found) != 0) return false;
+	for (addrinfo *a = found; a && handle == -1; a = a->ai_next) {
+		NativeSocket s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (s == invalidSocket) continue;
+		if (::connect(s, a->ai_addr, (int)a->ai_addrlen) == 0) {
+			setNoDelay(s);
+			handle = (int64_t)s;
+		}
+		else closeSocket(s);
+	}
+	freeaddrinfo(found);
+	return handle != -1;
+}
+
+// Bind to port on every interface, or only the loopback one when localOnly
+//
+bool Socket::listen(int port, bool localOnly) {
+	close();
+	if (!startSockets()) return false;
+
+	NativeSocket s = socket(AF_INET, SOCK_STREAM, 0);
+	if (s == invalidSocket) return false;
+	int one = 1;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&one, sizeof(one));		// so the port can be reused right after a render
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(localOnly ? INADDR_LOOPBACK : INADDR_ANY);
+	address.sin_port = htons(port);
+	if (::bind(s, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(s, 16) != 0) {
+		closeSocket(s);
+		return false;
+	}
+	handle = (int64_t)s;
+	return true;
+}
+
+// Wait up to timeoutSeconds for a connection; the caller owns the socket returned
+//
+Socket *Socket::accept(float timeoutSeconds) {
+	if (!waitReadable(timeoutSeconds)) return NULL;
+	NativeSocket connection = ::accept((NativeSocket)handle, NULL, NULL);
+	if (connection == invalidSocket) return NULL;
+	setNoDelay(connection);
+	Socket *socket = new Socket();
+	socket->handle = (int64_t)connection;
+	return socket;
+}
+
+// select() on the socket alone, so a thread can keep checking whether it should stop
+//
+bool Socket::waitReadable(float timeoutSeconds) {
+	if (handle == -1) return false;
+	NativeSocket s = (NativeSocket)handle;
+	fd_set ready;
+	FD_ZERO(&ready);
+	FD_SET(s, &ready);
+	timeval wait;
+	wait.tv_sec = (long)timeoutSeconds;
+	wait.tv_usec = (long)((timeoutSeconds - wait.tv_sec) * 1e6);
+	return select((int)s + 1, &ready, NULL, NULL, &wait) > 0;
+}
+
+// SO_RCVTIMEO takes milliseconds on Windows and a timeval everywhere else
+//
+void Socket::setReceiveTimeout(float seconds) {
+	if (handle == -1) return;
+#ifdef _WIN32
+	DWORD wait = (DWORD)(seconds * 1000);
+#else
+	timeval wait;
+	wait.tv_sec = (long)seconds;
+	wait.tv_usec = (long)((seconds - wait.tv_sec) * 1e6);
+#endif
+	setsockopt((NativeSocket)handle, SOL_SOCKET, SO_RCVTIMEO, (const char *)&wait, sizeof(wait));
+}
+
+// Send in pieces of at most 1MB until everything has gone or the connection fails
+//
+bool Socket::sendAll(const void *data, size_t length) {
+	const char *p = (const char *)data;
+	while (length > 0 && handle != -1) {
+		int n = send((NativeSocket)handle, p, (int)min(length, (size_t)1 << 20), 0);
+		if (n <= 0) return false;
+		p += n;
+		length -= n;
+	}
+	return handle != -1;
+}
+
+// Fails on a closed connection and when the receive timeout runs out
+//
+bool Socket::receiveAll(void *data, size_t length) {
+	char *p = (char *)data;
+	while (length > 0 && handle != -1) {
+		int n = recv((NativeSocket)handle, p, (int)min(length, (size_t)1 << 20), 0);
+		if (n <= 0) return false;
+		p += n;
+		length -= n;
+	}
+	return handle != -1;
+}
+
+// Safe to call more than once
+//
+void Socket::close() {
+	if (handle == -1) return;
+	closeSocket((NativeSocket)handle);
+	handle = -1;
+}
+
+// Both ends are assumed to have the same byte order, which every machine this runs on does
+//
+bool Socket::sendMessage(uint32_t type, const vector<char> &payload) {
+	char header[12];
+	uint64_t length = payload.size();
+	memcpy(header, &type, 4);
+	memcpy(header + 4, &length, 8);
+	return sendAll(header, sizeof(header)) && sendAll(payload.data(), payload.size());
+}
+
+// Read a header, check its length against maxLength, then read that much payload
+//
+bool Socket::receiveMessage(uint32_t &type, vector<char> &payload, uint64_t maxLength) {
+	char header[12];
+	if (!receiveAll(header, sizeof(header))) return false;
+	uint64_t length;
+	memcpy(&type, header, 4);
+	memcpy(&length, header + 4, 8);
+	if (length > maxLength) return false;		// not something we sent
+	payload.resize(length);
+	return receiveAll(payload.data(), length);
+}
+
+enum ObjectType : uint32_t {
+	OBJ_SKIPPED = 0,
+	OBJ_SPHERE,
+	OBJ_PLANE,
+	OBJ_MESH,
+	OBJ_OUT_OF_CORE_MESH,
+	OBJ_LIGHT,
+	OBJ_SPOTLIGHT,
+};
+
+// What every object has, whatever its type
+//
+static void writeCommon(SceneObject *obj, ByteWriter &w) {
+	w.put(obj->position);
+	w.put((ofColor)obj->diffuseColor);
+	w.put((ofColor)obj->specularColor);
+	w.put(obj->isVisible);
+	w.put(obj->isSelectable);
+}
+
+// The other half of writeCommon()
+//
+static void readCommon(SceneObject *obj, ByteReader &r) {
+	obj->position = r.get<glm::vec3>();
+	obj->diffuseColor = r.get<ofColor>();
+	obj->specularColor = r.get<ofColor>();
+	obj->isVisible = r.get<bool>();
+	obj->isSelectable = r.get<bool>();
+}
+
+// Every ofApp setting that changes what a render looks like, in a fixed order
+//
+void writeSettings(ofApp *app, ByteWriter &w) {
+	w.put((float)app->lightFalloff);
+	w.put((float)app->phongPower);
+	w.put((float)app->ambientStrength);
+	w.put((float)app->aaThreshold);
+	w.put((int)app->aaGrid);
+	w.put((bool)app->lightImportance);
+	w.put((int)app->lightSamples);
+	w.put((bool)app->wavefront);
+	w.put((bool)app->specializedKernels);
+	w.put((bool)app->sortShadowRays);
+	w.put((float)app->lodError);
+}
+
+// In the order writeSettings() put them
+//
+bool readSettings(ofApp *app, ByteReader &r) {
+	app->lightFalloff = r.get<float>();
+	app->phongPower = r.get<float>();
+	app->ambientStrength = r.get<float>();
+	app->aaThreshold = r.get<float>();
+	app->aaGrid = r.get<int>();
+	app->lightImportance = r.get<bool>();
+	app->lightSamples = r.get<int>();
+	app->wavefront = r.get<bool>();
+	app->specializedKernels = r.get<bool>();
+	app->sortShadowRays = r.get<bool>();
+	app->lodError = r.get<float>();
+	return r.ok;
+}
+
+// Where the render camera is and the window it looks through
+//
+void writeCamera(RenderCam &cam, ByteWriter &w) {
+	w.put(cam.position);
+	w.put(cam.aim);
+	w.put(cam.view.position);
+	w.put(cam.view.min);
+	w.put(cam.view.max);
+}
+
+// In the order writeCamera() put them
+//
+bool readCamera(RenderCam &cam, ByteReader &r) {
+	cam.position = r.get<glm::vec3>();
+	cam.aim = r.get<glm::vec3>();
+	cam.view.position = r.get<glm::vec3>();
+	cam.view.min = r.get<glm::vec2>();
+	cam.view.max = r.get<glm::vec2>();
+	return r.ok;
+}
+
+// The object count, then each object as its type and what that type needs; unknown types are written as skipped
+//
+void writeScene(ofApp *app, ByteWriter &w) {
+	w.put((uint32_t)app->scene.size());
+	for (SceneObject *obj : app->scene) {
+		if (Spotlight *spot = dynamic_cast<Spotlight *>(obj)) {		// before Light, which it derives from
+			w.put(OBJ_SPOTLIGHT);
+			writeCommon(obj, w);
+			w.put((float)spot->intensity);
+			w.put((glm::vec3)spot->direction);
+			w.put((float)spot->angle);
+		}
+		else if (Light *light = dynamic_cast<Light *>(obj)) {
+			w.put(OBJ_LIGHT);
+			writeCommon(obj, w);
+			w.put((float)light->intensity);
+		}
+		else if (Sphere *sphere = dynamic_cast<Sphere *>(obj)) {
+			w.put(OBJ_SPHERE);
+			writeCommon(obj, w);
+			w.put((float)sphere->radius);
+		}
+		else if (Plane *plane = dynamic_cast<Plane *>(obj)) {
+			w.put(OBJ_PLANE);
+			writeCommon(obj, w);
+			w.put(plane->getNormal());
+			w.put((float)plane->width);
+			w.put((float)plane->height);
+			w.put(plane->bInfinite);
+			w.put(plane->isTextured());
+			if (plane->isTextured()) {
+				ofImage texture = plane->getTexture();		// a copy, which has to outlive the pixels read from it
+				const ofPixels &pixels = texture.getPixels();
+				w.put((int)pixels.getWidth());
+				w.put((int)pixels.getHeight());
+				w.put((int)pixels.getNumChannels());
+				w.putVector(vector<unsigned char>(pixels.getData(), pixels.getData() + pixels.getTotalBytes()));
+			}
+		}
+		else if (Mesh *mesh = dynamic_cast<Mesh *>(obj)) {
+			w.put(OBJ_MESH);
+			writeCommon(obj, w);
+			w.put((float)mesh->scale);
+			w.put((glm::vec3)mesh->rotation);
+			w.putVector(mesh->verts);
+			vector<int> indices;
+			indices.reserve(mesh->triangles.size() * 3);
+			for (const Tri &t : mesh->triangles) indices.insert(indices.end(), t.vInd, t.vInd + 3);
+			w.putVector(indices);
+		}
+		else if (OutOfCoreMesh *mesh = dynamic_cast<OutOfCoreMesh *>(obj)) {
+			w.put(OBJ_OUT_OF_CORE_MESH);
+			writeCommon(obj, w);
+			w.put((float)mesh->scale);
+			w.put((glm::vec3)mesh->rotation);
+			w.put(mesh->chunkTriangles);
+			w.putString(mesh->getSourceFileName());
+		}
+		else {
+			w.put(OBJ_SKIPPED);
+			cout << "an object of a type that can't be sent was left out of the packed scene" << endl;
+		}
+	}
+}
+
+// The objects read replace the scene; the old ones are left alone, since whoever kept them may still need them.
+// If reading fails partway, the objects read so far are still in the scene, for the caller to dispose of.
+//
+bool readScene(ofApp *app, ByteReader &r, SceneAssets *assets) {
+	app->scene.clear();
+	app->lights.clear();
+	app->selected.clear();
+	uint32_t count = r.get<uint32_t>();
+	for (uint32_t i = 0; i < count && r.ok; i++) {
+		uint32_t type = r.get<uint32_t>();
+		if (type == OBJ_SKIPPED) continue;
+		glm::vec3 zero(0, 0, 0);
+		SceneObject *obj = NULL;
+
+		switch (type) {
+		case OBJ_SPOTLIGHT: {
+			Spotlight *spot = new Spotlight(zero, 1, glm::vec3(0, -1, 0), 10);
+			readCommon(spot, r);
+			spot->intensity = r.get<float>();
+			spot->direction = r.get<glm::vec3>();
+			spot->angle = r.get<float>();
+			app->lights.push_back(spot);
+			obj = spot;
+			break;
+		}
+		case OBJ_LIGHT: {
+			Light *light = new Light(zero, 1);
+			readCommon(light, r);
+			light->intensity = r.get<float>();
+			app->lights.push_back(light);
+			obj = light;
+			break;
+		}
+		case OBJ_SPHERE: {
+			Sphere *sphere = new Sphere(zero, 1);
+			readCommon(sphere, r);
+			sphere->radius = r.get<float>();
+			obj = sphere;
+			break;
+		}
+		case OBJ_PLANE: {
+			Plane *plane = new Plane(zero, glm::vec3(0, 1, 0));
+			readCommon(plane, r);
+			plane->setNormal(r.get<glm::vec3>());
+			plane->width = r.get<float>();
+			plane->height = r.get<float>();
+			plane->bInfinite = r.get<bool>();
+			app->scene.push_back(plane);
+			if (r.get<bool>()) {
+				int width = r.get<int>(), height = r.get<int>(), channels = r.get<int>();
+				vector<unsigned char> data;
+				r.getVector(data);
+				if (!r.ok || channels < 1 || channels > 4 || data.size() != (size_t)width * height * channels) return false;
+				uint64_t key = 14695981039346656037ull;
+				hashValue(key, width);
+				hashValue(key, height);
+				hashValue(key, channels);
+				hashBytes(key, data.data(), data.size());
+				if (assets) assets->keys[plane] = key;
+				if (assets && assets->textures.count(key)) {
+					Plane *prepared = assets->textures[key];
+					plane->setTexture(prepared->getTexture(), prepared->getMipTexture());
+					continue;
+				}
+				ofPixels pixels;
+				pixels.setFromPixels(data.data(), width, height, channels);
+				ofImage texture;
+				texture.setUseTexture(!app->bHeadless);
+				texture.setFromPixels(pixels);
+				plane->setTexture(texture);
+				if (assets) assets->textures[key] = plane;
+			}
+			continue;
+		}
+		case OBJ_MESH: {
+			Mesh *mesh = new Mesh(zero);
+			readCommon(mesh, r);
+			mesh->scale = r.get<float>();
+			mesh->rotation = r.get<glm::vec3>();
+			app->scene.push_back(mesh);
+			vector<glm::vec3> verts;
+			vector<int> indices;
+			r.getVector(verts);
+			r.getVector(indices);
+			if (!r.ok) return false;
+			uint64_t key = 14695981039346656037ull;
+			hashBytes(key, verts.data(), verts.size() * sizeof(glm::vec3));
+			hashBytes(key, indices.data(), indices.size() * sizeof(int));
+			if (assets) assets->keys[mesh] = key;
+			if (assets && assets->meshes.count(key)) {
+				mesh->copyGeometry(*assets->meshes[key]);
+				continue;
+			}
+			mesh->verts = std::move(verts);
+			for (int k = 0; k + 2 < indices.size(); k += 3) {
+				for (int v = k; v < k + 3; v++) {
+					if (indices[v] < 0 || indices[v] >= mesh->verts.size()) return false;
+				}
+				mesh->triangles.push_back(Tri(indices[k], indices[k + 1], indices[k + 2]));
+			}
+			mesh->prepareGeometry();
+			if (assets) assets->meshes[key] = mesh;
+			continue;
+		}
+		case OBJ_OUT_OF_CORE_MESH: {
+			OutOfCoreMesh *mesh = new OutOfCoreMesh(zero);
+			readCommon(mesh, r);
+			mesh->scale = r.get<float>();
+			mesh->rotation = r.get<glm::vec3>();
+			mesh->chunkTriangles = r.get<int>();
+			string fileName = r.getString();
+			if (!r.ok || !mesh->build(fileName)) {
+				cout << "couldn't rebuild out-of-core mesh " << fileName << ", leaving it out" << endl;
+				delete mesh;
+				continue;
+			}
+			obj = mesh;
+			break;
+		}
+		default:
+			return false;
+		}
+		app->scene.push_back(obj);
+	}
+	return r.ok;
+}
+
+// Start the app again as workers connecting back to us. system() waits for the process, so each gets its own thread.
+//
+void RenderCoordinator::launchLocalWorkers() {
+	string command = "\"" + ofFilePath::getCurrentExePath() + "\" --worker 127.0.0.1:" + ofToString(port);
+#ifdef _WIN32
+	command = "\"" + command + "\"";		// cmd.exe takes off the outer pair of quotes
+#endif
+	for (int i = 0; i < localWorkers; i++) {
+		std::thread([command] { std::system(command.c_str()); }).detach();
+	}
+}
+
+// The next tile for a worker that just became free: one nobody has, else a second copy of the tile that's been out
+// longest, since its worker may be slow or stuck
+//
+int RenderCoordinator::nextTile() {
+	while (!queue.empty()) {
+		int t = queue.front();
+		queue.pop_front();
+		if (!tiles[t].done) return t;
+	}
+	int oldest = -1;
+	for (int t = 0; t < tiles.size(); t++) {
+		if (tiles[t].done || tiles[t].copies >= 2) continue;
+		if (oldest < 0 || tiles[t].issued < tiles[oldest].issued) oldest = t;
+	}
+	if (oldest >= 0 && tiles[oldest].copies > 0) reissued++;
+	return oldest;
+}
+
+// Keep the first result for a tile; later copies are dropped
+//
+void RenderCoordinator::finishTile(int t, const ofPixels &pixels, int worker) {
+	std::lock_guard<std::mutex> lock(tilesMutex);
+	Tile &tile = tiles[t];
+	if (worker >= 0) tile.copies--;
+	if (!tile.done) {
+		pixels.pasteInto(*image, tile.x, tile.y);
+		tile.done = true;
+		remaining--;
+		if (worker >= 0) tilesPerWorker[worker]++;
+	}
+	tilesChanged.notify_all();
+}
+
+// Send a worker the scene, then tiles one at a time until there are none left. Preparing the scene can take much
+// longer than a tile, so the tile timeout only starts once the worker says it's ready. If the worker goes away or is
+// too slow, the tile it had goes back to the front of the queue.
+//
+void RenderCoordinator::serveWorker(Socket *socket, int worker) {
+	Tracer::setThreadName("worker connection " + ofToString(worker));
+	socket->setReceiveTimeout(tileTimeout);
+	uint32_t type;
+	vector<char> payload;
+	bool ok = socket->receiveMessage(type, payload, maxSmallMessage) && type == MSG_HELLO && socket->sendMessage(MSG_SCENE, sceneMessage);
+	if (ok) {
+		ByteReader hello(payload);
+		cout << "worker " << worker << " connected, with " << hello.get<int>() << " threads" << endl;
+
+		// wait for the worker to prepare the scene; if the frame gets finished meanwhile it's just told it's done
+		uint64_t sent = ofGetElapsedTimeMillis();
+		bool readable = false, done = false;
+		while (!readable && !done && ofGetElapsedTimeMillis() - sent < sceneTimeout * 1000) {
+			{
+				std::lock_guard<std::mutex> lock(tilesMutex);
+				done = finished;
+			}
+			if (!done) readable = socket->waitReadable(0.25);
+		}
+		ok = done || (readable && socket->receiveMessage(type, payload, maxSmallMessage) && type == MSG_READY);
+		if (readable && ok) cout << "worker " << worker << " ready after " << (ofGetElapsedTimeMillis() - sent) / 1000.0 << "s" << endl;
+	}
+
+	int t = -1;
+	while (ok) {
+		Tile tile;
+		{
+			std::unique_lock<std::mutex> lock(tilesMutex);
+			while ((t = nextTile()) < 0 && remaining > 0) tilesChanged.wait_for(lock, std::chrono::milliseconds(100));
+			if (t < 0) break;
+			tiles[t].copies++;
+			tiles[t].issued = ofGetElapsedTimeMillis();
+			tile = tiles[t];
+		}
+
+		ByteWriter request;
+		request.put(t);
+		request.put(tile.x);
+		request.put(tile.y);
+		request.put(tile.w);
+		request.put(tile.h);
+		uint64_t maxResult = 5 * sizeof(int) + (uint64_t)tile.w * tile.h * 3;
+		ok = socket->sendMessage(MSG_TILE, request.bytes) && socket->receiveMessage(type, payload, maxResult) && type == MSG_RESULT;
+		if (ok) {
+			ByteReader result(payload);
+			int index = result.get<int>(), x = result.get<int>(), y = result.get<int>(), w = result.get<int>(), h = result.get<int>();
+			ok = result.ok && index == t && x == tile.x && y == tile.y && w == tile.w && h == tile.h
+				&& payload.size() - result.pos == (size_t)w * h * 3;
+			if (ok) {
+				ofPixels pixels;
+				pixels.setFromPixels((const unsigned char *)payload.data() + result.pos, w, h, OF_PIXELS_RGB);
+				finishTile(t, pixels, worker);
+				t = -1;
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(tilesMutex);
+		if (t >= 0) {
+			Tile &tile = tiles[t];
+			tile.copies--;
+			if (!tile.done && tile.copies == 0) queue.push_front(t);
+			cout << "lost worker " << worker << ", tile " << t << " goes back on the queue" << endl;
+		}
+		connectedWorkers--;
+		tilesChanged.notify_all();
+	}
+	if (ok) socket->sendMessage(MSG_DONE, vector<char>());
+	delete socket;
+}
+
+// Render the app's frame on whatever workers connect, putting tiles into result as they come back
+//
+bool RenderCoordinator::render(ofApp *app, ofPixels &result, bool aa) {
+	TRACE_SCOPE("distributed render", "render");
+	this->app = app;
+	int width = app->imageWidth, height = app->imageHeight;
+	Socket server;
+	if (!server.listen(port)) {
+		cout << "couldn't listen for workers on port " << port << endl;
+		return false;
+	}
+
+	// every worker gets the same scene, so pack it once
+	ByteWriter scene;
+	scene.put(width);
+	scene.put(height);
+	scene.put(aa);
+	scene.put(true);		// shadows
+	writeSettings(app, scene);
+	writeCamera(app->renderCam, scene);
+	writeScene(app, scene);
+	if (scene.bytes.size() > maxSceneMessage) {
+		cout << "scene is too big to send to workers (" << scene.bytes.size() / (1024 * 1024) << "MB)" << endl;
+		return false;
+	}
+	sceneMessage = std::move(scene.bytes);
+
+	result.allocate(width, height, OF_PIXELS_RGB);
+	image = &result;
+	tiles.clear();
+	queue.clear();
+	for (int y = 0; y < height; y += tileSize) {
+		for (int x = 0; x < width; x += tileSize) {
+			Tile tile;
+			tile.x = x;
+			tile.y = y;
+			tile.w = min(tileSize, width - x);
+			tile.h = min(tileSize, height - y);
+			queue.push_back(tiles.size());
+			tiles.push_back(tile);
+		}
+	}
+	remaining = tiles.size();
+	connectedWorkers = 0;
+	reissued = 0;
+	tilesPerWorker.clear();
+	finished = false;
+	uint64_t start = ofGetElapsedTimeMillis();
+	cout << "distributed render: " << tiles.size() << " tiles, " << sceneMessage.size() / 1024 << "kB of scene, listening on port " << port << endl;
+	launchLocalWorkers();
+
+	// workers can join at any point of the render, each served by its own thread
+	vector<std::thread> workerThreads;
+	std::thread acceptThread([&] {
+		Tracer::setThreadName("accept workers");
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock(tilesMutex);
+				if (finished) break;
+			}
+			Socket *socket = server.accept(0.25);
+			if (!socket) continue;
+			std::lock_guard<std::mutex> lock(tilesMutex);
+			connectedWorkers++;
+			tilesPerWorker.push_back(0);
+			workerThreads.emplace_back(&RenderCoordinator::serveWorker, this, socket, (int)tilesPerWorker.size() - 1);
+		}
+	});
+
+	bool ok = true;
+	uint64_t lastWorkerTime = ofGetElapsedTimeMillis();
+	std::unique_lock<std::mutex> lock(tilesMutex);
+	while (remaining > 0 && ok) {
+		tilesChanged.wait_for(lock, std::chrono::milliseconds(100));
+		if (connectedWorkers > 0) lastWorkerTime = ofGetElapsedTimeMillis();
+		if (remaining == 0 || connectedWorkers > 0 || ofGetElapsedTimeMillis() - lastWorkerTime < workerWait * 1000) continue;
+
+		// no one to give tiles to, so render the rest here; a worker that turns up meanwhile still helps
+		vector<int> left;
+		for (int t = 0; t < tiles.size(); t++) {
+			if (!tiles[t].done) left.push_back(t);
+		}
+		cout << "no workers, rendering the last " << left.size() << " tiles locally" << endl;
+		lock.unlock();
+		for (int t : left) {
+			ofPixels pixels;
+			{
+				std::lock_guard<std::mutex> check(tilesMutex);
+				if (tiles[t].done) continue;
+			}
+			if (!app->renderRegion(width, height, tiles[t].x, tiles[t].y, tiles[t].w, tiles[t].h, pixels, aa, true)) {
+				ok = false;
+				break;
+			}
+			pixels.setImageType(OF_IMAGE_COLOR);
+			finishTile(t, pixels, -1);
+		}
+		lock.lock();
+		lastWorkerTime = ofGetElapsedTimeMillis();
+	}
+	finished = true;
+	tilesChanged.notify_all();
+	lock.unlock();
+
+	acceptThread.join();
+	for (std::thread &thread : workerThreads) thread.join();
+	image = NULL;
+
+	cout << "distributed render " << (ok ? "finished" : "stopped") << " in " << (ofGetElapsedTimeMillis() - start) / 1000.0 << "s";
+	for (int i = 0; i < tilesPerWorker.size(); i++) cout << (i ? ", " : ": ") << "worker " << i << " " << tilesPerWorker[i] << " tiles";
+	cout << ", " << reissued << " tiles sent twice" << endl;
+	return ok;
+}
+
+// The port is after the last colon, so host names with colons in them still work
+//
+bool splitAddress(const string &address, string &host, int &port) {
+	size_t colon = address.rfind(':');
+	if (colon == string::npos) return false;
+	host = address.substr(0, colon);
+	port = ofToInt(address.substr(colon + 1));
+	return port > 0;
+}
+
+// Worker side: everything comes from the coordinator, and the app's own scene is replaced by the one it sends
+//
+bool runWorker(ofApp *app, const string &address) {
+	string host;
+	int port;
+	if (!splitAddress(address, host, port)) {
+		cout << "worker address should be host:port, not " << address << endl;
+		return false;
+	}
+
+	Socket socket;
+	bool connected = false;
+	for (int attempt = 0; attempt < 50 && !connected; attempt++) {		// the coordinator may not be listening yet
+		connected = socket.connect(host, port);
+		if (!connected) ofSleepMillis(200);
+	}
+	if (!connected) {
+		cout << "worker: couldn't connect to " << address << endl;
+		return false;
+	}
+
+	ByteWriter hello;
+	hello.put(app->renderThreads);
+	uint32_t type;
+	vector<char> payload;
+	if (!socket.sendMessage(MSG_HELLO, hello.bytes) || !socket.receiveMessage(type, payload, maxSceneMessage) || type != MSG_SCENE) {
+		cout << "worker: no scene from " << address << endl;
+		return false;
+	}
+	ByteReader scene(payload);
+	int width = scene.get<int>(), height = scene.get<int>();
+	bool aa = scene.get<bool>(), shadows = scene.get<bool>();
+	if (!readSettings(app, scene) || !readCamera(app->renderCam, scene) || !readScene(app, scene)) {
+		cout << "worker: couldn't read the scene from " << address << endl;
+		return false;
+	}
+	app->printProgress = false;
+	if (!socket.sendMessage(MSG_READY, vector<char>())) return false;
+	cout << "worker: rendering tiles of a " << width << "x" << height << " frame of " << app->scene.size() << " objects" << endl;
+
+	int rendered = 0;
+	while (socket.receiveMessage(type, payload, maxSmallMessage) && type == MSG_TILE) {
+		ByteReader tile(payload);
+		int index = tile.get<int>(), x = tile.get<int>(), y = tile.get<int>(), w = tile.get<int>(), h = tile.get<int>();
+		ofPixels pixels;
+		if (!tile.ok || !app->renderRegion(width, height, x, y, w, h, pixels, aa, shadows)) break;
+		pixels.setImageType(OF_IMAGE_COLOR);
+
+		ByteWriter result;
+		result.put(index);
+		result.put(x);
+		result.put(y);
+		result.put(w);
+		result.put(h);
+		result.bytes.insert(result.bytes.end(), (const char *)pixels.getData(), (const char *)pixels.getData() + pixels.getTotalBytes());
+		if (!socket.sendMessage(MSG_RESULT, result.bytes)) break;
+		rendered++;
+	}
+	cout << "worker: rendered " << rendered << " tiles" << endl;
+	return type == MSG_DONE;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Rendering one frame across several processes, on this machine or others.
+// The coordinator (the app, press n) listens on a TCP port and each worker (the app started with
+// --worker host:port) connects to it. A worker is sent the whole scene once, mesh geometry and textures included,
+// then asks for tiles one at a time and renders each with renderRegion, so faster workers simply do more of them.
+// A tile whose worker disconnects or takes longer than the tile timeout goes back on the queue, and once the queue
+// is empty idle workers also take copies of the tiles still out, keeping whichever result comes back first. If no
+// worker is left the coordinator renders the rest itself. Regions render exactly like the same pixels of a whole
+// frame, so the assembled image matches a local render.
+// Out-of-core meshes are sent as the path of their .obj file, so workers on other machines need the same file there.
+
+class ofApp;
+class RenderCam;
+class SceneObject;
+class Mesh;
+class Plane;
+
+//  Blocking TCP connection, or a socket listening for them
+//
+class Socket {
+public:
+	Socket() {}
+	~Socket() { close(); }
+	Socket(const Socket &) = delete;
+	Socket &operator=(const Socket &) = delete;
+
+	bool connect(const string &host, int port);
+	bool listen(int port, bool localOnly = false);		// localOnly only takes connections from this machine
+	Socket *accept(float timeoutSeconds);		// NULL if nobody connected in time
+	bool waitReadable(float timeoutSeconds);	// true once there's something to receive, or the other end closed
+	void setReceiveTimeout(float seconds);		// 0 waits forever
+	bool sendAll(const void *data, size_t length);
+	bool receiveAll(void *data, size_t length);
+	void close();
+	bool isOpen() { return handle != -1; }
+
+	// a message is its type and payload length followed by the payload. A payload longer than maxLength is refused
+	// before anything is allocated for it, since the length comes from whoever is on the other end.
+	bool sendMessage(uint32_t type, const vector<char> &payload);
+	bool receiveMessage(uint32_t &type, vector<char> &payload, uint64_t maxLength);
+
+private:
+	int64_t handle = -1;
+};
+
+//  Growing buffer that values are packed into for sending
+//
+struct ByteWriter {
+	vector<char> bytes;
+
+	template<class T> void put(const T &v) {
+		const char *p = (const char *)&v;
+		bytes.insert(bytes.end(), p, p + sizeof(T));
+	}
+	template<class T> void putVector(const vector<T> &v) {
+		put((uint64_t)v.size());
+		const char *p = (const char *)v.data();
+		bytes.insert(bytes.end(), p, p + v.size() * sizeof(T));
+	}
+	void putString(const string &s) {
+		put((uint64_t)s.size());
+		bytes.insert(bytes.end(), s.begin(), s.end());
+	}
+};
+
+//  Reads values back out in the order they were put; ok turns false if the buffer runs out
+//
+struct ByteReader {
+	const vector<char> &bytes;
+	size_t pos = 0;
+	bool ok = true;
+
+	ByteReader(const vector<char> &b) : bytes(b) {}
+
+	template<class T> T get() {
+		T v = T();
+		if (pos + sizeof(T) > bytes.size()) {
+			ok = false;
+			return v;
+		}
+		memcpy(&v, bytes.data() + pos, sizeof(T));
+		pos += sizeof(T);
+		return v;
+	}
+	template<class T> void getVector(vector<T> &v) {
+		uint64_t n = get<uint64_t>();
+		if (!ok || n > (bytes.size() - pos) / sizeof(T)) {
+			ok = false;
+			return;
+		}
+		v.resize(n);
+		memcpy(v.data(), bytes.data() + pos, n * sizeof(T));
+		pos += n * sizeof(T);
+	}
+	string getString() {
+		vector<char> chars;
+		getVector(chars);
+		return string(chars.begin(), chars.end());
+	}
+};
+
+const uint64_t maxSmallMessage = 64;				// hellos, tile requests, and the other fixed-size messages
+const uint64_t maxSceneMessage = (uint64_t)1 << 31;	// 2GB; meshes bigger than that go out-of-core and are sent by file name
+
+enum MessageType : uint32_t {
+	MSG_HELLO = 1,		// worker -> coordinator: how many render threads it has
+	MSG_SCENE,			// coordinator -> worker: frame size, settings, camera and scene; client -> render server: settings and scene
+	MSG_READY,			// worker -> coordinator: scene read and prepared, send tiles
+	MSG_TILE,			// coordinator -> worker: tile index and rectangle to render
+	MSG_RESULT,			// worker -> coordinator: tile index, rectangle and RGB pixels
+	MSG_DONE,			// coordinator -> worker: no more tiles, exit; client -> render server: end of session
+	MSG_JOB,			// client -> render server: scene key, frame size and camera (see RenderServer.h)
+	MSG_NEED_SCENE,		// render server -> client: send the scene for that key
+	MSG_IMAGE,			// render server -> client: size, whether it came from the cache, and RGB pixels
+};
+
+//  Meshes and textures already prepared, so reading a scene that has them again skips the work
+//
+struct SceneAssets {
+	map<uint64_t, Mesh *> meshes;		// by hash of vertices and triangles
+	map<uint64_t, Plane *> textures;	// by hash of texture pixels
+	map<SceneObject *, uint64_t> keys;	// every mesh and textured plane read, with its key, so another can stand in for one
+};
+
+// Pack what a render depends on: the render settings, the render camera, and every scene object.
+// Reading settings or a camera sets the app's; readScene replaces the app's scene with the objects packed, taking
+// prepared meshes and textures from assets when it can and adding the ones it prepares. The readers return false if
+// the data was bad.
+void writeSettings(ofApp *app, ByteWriter &w);
+bool readSettings(ofApp *app, ByteReader &r);
+void writeCamera(RenderCam &cam, ByteWriter &w);
+bool readCamera(RenderCam &cam, ByteReader &r);
+void writeScene(ofApp *app, ByteWriter &w);
+bool readScene(ofApp *app, ByteReader &r, SceneAssets *assets = NULL);
+
+//  Hands tiles of one frame out to worker processes and puts the image together
+//
+class RenderCoordinator {
+public:
+	// Render imageWidth x imageHeight into result; false if it couldn't listen on the port
+	bool render(ofApp *app, ofPixels &result, bool aa);
+
+	int port = 9240;
+	int localWorkers = 2;		// worker processes to start on this machine, besides any that connect on their own
+	int tileSize = 128;			// each tile is one renderRegion on the worker, so not too small
+	float sceneTimeout = 600;	// seconds a worker may spend reading and preparing the scene before it's given up on
+	float tileTimeout = 60;		// seconds a worker may spend on one tile before it's given up on
+	float workerWait = 15;		// seconds to wait with no worker connected before rendering locally
+
+private:
+	struct Tile {
+		int x, y, w, h;			// in output pixels from the top left
+		bool done = false;
+		int copies = 0;			// workers rendering it right now
+		uint64_t issued = 0;	// ofGetElapsedTimeMillis() when it was last handed out
+	};
+
+	int nextTile();				// call with tilesMutex held; -1 if nothing needs doing right now
+	void serveWorker(Socket *socket, int index);
+	void finishTile(int t, const ofPixels &pixels, int worker);
+	void launchLocalWorkers();
+
+	ofApp *app;
+	ofPixels *image;
+	vector<char> sceneMessage;
+
+	std::mutex tilesMutex;
+	std::condition_variable tilesChanged;
+	vector<Tile> tiles;
+	std::deque<int> queue;
+	int remaining = 0;
+	int connectedWorkers = 0;
+	int reissued = 0;
+	vector<int> tilesPerWorker;
+	bool finished = false;
+};
+
+// Split "host:port"; false if there's no port
+bool splitAddress(const string &address, string &host, int &port);
+
+// Connect to a coordinator at host:port and render the tiles it hands out until it says it's done
+bool runWorker(ofApp *app, const string &address);
@@ -0,0 +1,232 @@
+#include "ImageWriter.h"
+#include "Tracer.h"
+#include "FreeImage.h"
+
+// Files can be bigger than a long can count on Windows
+//
+static int seekTo(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+	return _fseeki64(file, (int64_t)offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+// A negative PFM scale means little-endian floats, which is what every machine this runs on writes
+//
+static string fileHeader(bool floats, int width, int height) {
+	return string(floats ? "PF" : "P6") + "\n" + ofToString(width) + " " + ofToString(height) + "\n" + (floats ? "-1.0" : "255") + "\n";
+}
+
+// Write an RGB block into place in a PPM or PFM file of width x height, with (x, y) its top left corner
+//
+static bool writeBlock(FILE *file, bool floats, int width, int height, size_t headerBytes, int x, int y, const ofPixels &block) {
+	int w = block.getWidth(), h = block.getHeight();
+	if (x < 0 || y < 0 || x + w > width || y + h > height) return false;
+	size_t pixelBytes = floats ? 3 * sizeof(float) : 3;
+	vector<float> row(floats ? w * 3 : 0);
+	for (int r = 0; r < h; r++) {
+		int fileRow = floats ? height - 1 - (y + r) : y + r;		// PFM rows go from the bottom up
+		if (seekTo(file, headerBytes + ((uint64_t)fileRow * width + x) * pixelBytes) != 0) return false;
+		const unsigned char *src = block.getData() + (size_t)r * w * 3;
+		size_t written;
+		if (floats) {
+			for (int k = 0; k < w * 3; k++) row[k] = src[k] / 255.0f;
+			written = fwrite(row.data(), sizeof(float), w * 3, file) * sizeof(float);
+		}
+		else written = fwrite(src, 1, w * 3, file);
+		if (written != w * pixelBytes) return false;
+	}
+	return true;
+}
+
+// PNG through FreeImage itself, since ofSaveImage has no say over the compression level
+//
+static bool savePng(ofPixels &pixels, const string &path, int level) {
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	pixels.swapRgb();		// FreeImage's byte order; pixels is the writer's own copy
+#endif
+	int w = pixels.getWidth(), h = pixels.getHeight();
+	FIBITMAP *bitmap = FreeImage_ConvertFromRawBits(pixels.getData(), w, h, w * 3, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, true);
+	if (!bitmap) return false;
+	bool ok = FreeImage_Save(FIF_PNG, bitmap, path.c_str(), (level <= 0) ? PNG_Z_NO_COMPRESSION : min(level, 9));
+	FreeImage_Unload(bitmap);
+	return ok;
+}
+
+// Pick the format from the extension of path (absolute)
+//
+static bool savePixels(ofPixels &pixels, const string &path, int pngCompression) {
+	string ext = ofToLower(ofFilePath::getFileExt(path));
+	if (ext == "ppm" || ext == "pfm") {
+		FILE *file = fopen(path.c_str(), "wb");
+		if (!file) return false;
+		bool floats = (ext == "pfm");
+		string header = fileHeader(floats, pixels.getWidth(), pixels.getHeight());
+		bool ok = fwrite(header.data(), 1, header.size(), file) == header.size()
+			&& writeBlock(file, floats, pixels.getWidth(), pixels.getHeight(), header.size(), 0, 0, pixels);
+		return fclose(file) == 0 && ok;
+	}
+	if (ext == "png") return savePng(pixels, path, pngCompression);
+	return ofSaveImage(pixels, path);
+}
+
+// Make the folder a file path is in, along with any folders above it
+//
+static void makeFolderFor(const string &path) {
+	string folder = ofFilePath::getEnclosingDirectory(path, false);
+	if (!folder.empty()) ofDirectory::createDirectory(folder, false, true);
+}
+
+// Everything queued is still written before the writer goes away
+//
+ImageWriter::~ImageWriter() {
+	if (!thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	thread.join();
+	for (auto &entry : streams) fclose(entry.second.file);
+	FreeImage_DeInitialise();
+}
+
+void ImageWriter::start() {
+	FreeImage_Initialise();		// counted, so it doesn't matter that openFrameworks does it too
+	thread = std::thread(&ImageWriter::writerLoop, this);
+}
+
+// Wait for room in the queue, then queue work. Before start() the work is done right away instead.
+//
+void ImageWriter::add(std::function<void()> work, size_t bytes) {
+	if (!thread.joinable()) {
+		work();
+		return;
+	}
+	std::unique_lock<std::mutex> lock(jobsMutex);
+	jobDone.wait(lock, [&] { return queuedBytes == 0 || queuedBytes + bytes <= maxQueuedBytes; });
+	queued.push_back({ work, bytes });
+	queuedBytes += bytes;
+	jobReady.notify_one();
+}
+
+// Copy the pixels into the job, so the caller can reuse its buffer right away
+//
+void ImageWriter::write(ofPixels pixels, string fileName) {
+	size_t bytes = pixels.getTotalBytes();
+	int compression = pngCompression;
+	uint64_t queuedTime = ofGetElapsedTimeMillis();
+	add([pixels, fileName, compression, queuedTime]() mutable {
+		TRACE_SCOPE_ARGS("save image", "save", "\"file\":\"" + ofFilePath::getFileName(fileName) + "\"");
+		string path = ofToDataPath(fileName, true);
+		makeFolderFor(path);
+		if (pixels.getNumChannels() != 3) pixels.setImageType(OF_IMAGE_COLOR);
+		bool ok = savePixels(pixels, path, compression);
+		cout << (ok ? "saved " : "couldn't save ") << fileName << ", " << (ofGetElapsedTimeMillis() - queuedTime) / 1000.0 << "s after it was queued" << endl;
+	}, bytes);
+}
+
+// The whole file is sized up front; pixels not written yet read as black, and most file systems don't even store them
+//
+int ImageWriter::beginStream(string fileName, int width, int height) {
+	string path = ofToDataPath(fileName, true);
+	string ext = ofToLower(ofFilePath::getFileExt(path));
+	if (ext != "ppm" && ext != "pfm") return -1;
+	makeFolderFor(path);
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) return -1;
+
+	Stream stream;
+	stream.file = file;
+	stream.floats = (ext == "pfm");
+	stream.width = width;
+	stream.height = height;
+	stream.fileName = fileName;
+	stream.startTime = ofGetElapsedTimeMillis();
+	string header = fileHeader(stream.floats, width, height);
+	stream.headerBytes = header.size();
+	uint64_t total = header.size() + (uint64_t)width * height * (stream.floats ? 3 * sizeof(float) : 3);
+	if (fwrite(header.data(), 1, header.size(), file) != header.size() || seekTo(file, total - 1) != 0 || fputc(0, file) == EOF) {
+		fclose(file);
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(jobsMutex);
+	streams[nextStream] = stream;
+	return nextStream++;
+}
+
+// Tiles of a stream that has already been ended are dropped
+//
+void ImageWriter::writeTile(int stream, int x, int y, ofPixels tile) {
+	size_t bytes = tile.getTotalBytes();
+	add([this, stream, x, y, tile]() mutable {
+		Stream s;
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex);
+			auto found = streams.find(stream);
+			if (found == streams.end()) return;
+			s = found->second;
+		}
+		TRACE_SCOPE("write tile", "save");
+		if (tile.getNumChannels() != 3) tile.setImageType(OF_IMAGE_COLOR);
+		if (!writeBlock(s.file, s.floats, s.width, s.height, s.headerBytes, x, y, tile)) cout << "couldn't write a tile of " << s.fileName << endl;
+	}, bytes);
+}
+
+// Queued behind the stream's tiles, so the file is only closed once they are all written
+//
+void ImageWriter::endStream(int stream) {
+	add([this, stream] {
+		Stream s;
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex);
+			auto found = streams.find(stream);
+			if (found == streams.end()) return;
+			s = found->second;
+			streams.erase(found);
+		}
+		bool ok = fclose(s.file) == 0;
+		cout << (ok ? "saved " : "couldn't finish ") << s.fileName << ", " << (ofGetElapsedTimeMillis() - s.startTime) / 1000.0 << "s after it was begun" << endl;
+	}, 0);
+}
+
+// Block until everything queued so far has been written
+//
+void ImageWriter::waitIdle() {
+	if (!thread.joinable()) return;
+	std::unique_lock<std::mutex> lock(jobsMutex);
+	jobDone.wait(lock, [this] { return queued.empty() && !busy; });
+}
+
+// Images and tiles queued or being written right now
+//
+int ImageWriter::getNumPending() {
+	std::lock_guard<std::mutex> lock(jobsMutex);
+	return queued.size() + (busy ? 1 : 0);
+}
+
+// Write until the writer is destroyed and the queue is empty
+//
+void ImageWriter::writerLoop() {
+	Tracer::setThreadName("image writer");
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(jobsMutex);
+			jobReady.wait(lock, [this] { return stopping || !queued.empty(); });
+			if (queued.empty()) return;
+			job = std::move(queued.front());
+			queued.pop_front();
+			busy = true;
+		}
+		job.work();
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex);
+			queuedBytes -= job.bytes;
+			busy = false;
+		}
+		jobDone.notify_all();
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Saving rendered images on a background thread, so the next render can start while the last image is still being
+// written. The format comes from the file extension:
+//   .ppm	binary 8-bit RGB, written as is, with no encoding to speak of
+//   .pfm	32-bit float RGB (the 8-bit colors scaled to 0..1), also written as is
+//   .png	compressed at a chosen zlib level: 0 stores it uncompressed, 9 is smallest and slowest
+//   other	whatever ofSaveImage makes of it
+// PPM and PFM files can also be streamed: the file is laid out when it's begun and tiles are written into place as they
+// arrive, in any order, so a frame much bigger than memory never has to be held whole.
+// Images waiting to be written are held in memory, so once more than maxQueuedBytes are waiting, queueing another
+// waits for the writer to catch up.
+
+//  The writer thread and its queue
+//
+class ImageWriter {
+public:
+	~ImageWriter();
+
+	void start();
+
+	// Queue RGB pixels to be saved to fileName (in bin/data; folders are made as needed)
+	void write(ofPixels pixels, string fileName);
+
+	// Create a width x height PPM or PFM file to fill in with writeTile(); returns the stream, or -1 if the file
+	// couldn't be made or the format can't be streamed. (x, y) of a tile is its top left corner.
+	int beginStream(string fileName, int width, int height);
+	void writeTile(int stream, int x, int y, ofPixels tile);
+	void endStream(int stream);
+
+	void waitIdle();			// until everything queued has been written
+	int getNumPending();
+
+	int pngCompression = 6;
+	size_t maxQueuedBytes = (size_t)1 << 30;
+
+private:
+	struct Job {
+		std::function<void()> work;
+		size_t bytes;
+	};
+	struct Stream {
+		FILE *file;
+		bool floats;			// PFM rather than PPM
+		int width, height;
+		size_t headerBytes;
+		string fileName;
+		uint64_t startTime;		// ofGetElapsedTimeMillis() when it was begun
+	};
+
+	void add(std::function<void()> work, size_t bytes);
+	void writerLoop();
+
+	std::thread thread;
+	std::mutex jobsMutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobDone;
+	std::deque<Job> queued;
+	size_t queuedBytes = 0;
+	bool busy = false;
+	bool stopping = false;
+	map<int, Stream> streams;
+	int nextStream = 0;
+};
@@ -0,0 +1,195 @@
+#include "Kernels.h"
+#include "ofApp.h"
+#include <typeinfo>
+
+// Sort the visible objects into per-type lists. Types are matched exactly, since a subclass might override
+// intersect() and the kernels call the base versions directly.
+//
+void SceneLists::build(const vector<SceneObject *> &scene, const vector<Light *> &lights) {
+	planes.clear();
+	spheres.clear();
+	meshes.clear();
+	lightObjects.clear();
+	hasTexturedPlanes = hasSpotlights = hasOthers = false;
+
+	for (SceneObject *obj : scene) {
+		if (!obj->isVisible) continue;
+		const std::type_info &type = typeid(*obj);
+		if (type == typeid(Plane)) {
+			Plane *plane = static_cast<Plane *>(obj);
+			planes.push_back(plane);
+			if (plane->isTextured()) hasTexturedPlanes = true;
+		}
+		else if (type == typeid(Sphere)) spheres.push_back(static_cast<Sphere *>(obj));
+		else if (type == typeid(Mesh)) meshes.push_back(static_cast<Mesh *>(obj));
+		else if (type == typeid(Light) || type == typeid(Spotlight)) lightObjects.push_back(static_cast<Light *>(obj));
+		else hasOthers = true;
+	}
+
+	for (Light *l : lights) {
+		const std::type_info &type = typeid(*l);
+		if (type == typeid(Spotlight)) hasSpotlights = true;
+		else if (type != typeid(Light)) hasOthers = true;		// might override isBlocked()
+	}
+}
+
+// Closest hit among one list of objects; returns the object that became the closest hit, if any
+//
+template<class T>
+static T *closestOf(const vector<T *> &objs, const Ray &ray, HitRecord &hit) {
+	glm::vec3 intersectPt, normal;
+	T *best = NULL;
+	for (T *obj : objs) {
+		if (obj->T::intersect(ray, intersectPt, normal)) {
+			float dist = glm::distance(ray.p, intersectPt);
+			if (dist < hit.dist) {
+				hit.dist = dist;
+				hit.point = intersectPt;
+				hit.normal = normal;
+				hit.obj = obj;
+				best = obj;
+			}
+		}
+	}
+	return best;
+}
+
+// Same as ofApp::closestHit. If the hit is on a plane, it's passed back through hitPlane for texturing.
+//
+template<bool Textures, bool Meshes>
+static bool closestHit(const SceneLists &s, const Ray &ray, HitRecord &hit, Plane *&hitPlane) {
+	hit.obj = NULL;
+	hit.dist = numeric_limits<float>::infinity();
+
+	Plane *plane = closestOf(s.planes, ray, hit);
+	closestOf(s.spheres, ray, hit);
+	if (Meshes) closestOf(s.meshes, ray, hit);
+	closestOf(s.lightObjects, ray, hit);
+
+	hitPlane = (Textures && hit.obj == plane) ? plane : NULL;
+	return hit.obj != NULL;
+}
+
+// True if something in objs lies on the segment from origin to maxDist along ray; a blocker found becomes last
+//
+template<class T>
+static bool blockedBy(const vector<T *> &objs, const Ray &ray, float maxDist, SceneObject *&last) {
+	glm::vec3 intersectPt, normal;
+	for (T *obj : objs) {
+		if (obj == last) continue;		// already tested
+		if (obj->T::intersect(ray, intersectPt, normal) && glm::distance(intersectPt, ray.p) < maxDist) {
+			last = obj;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Same as Light::isBlocked (and Spotlight::isBlocked when the scene has spotlights), including the occluder cache
+//
+template<bool Spots, bool Meshes>
+static bool occluded(const SceneLists &s, const LightInfo *info, glm::vec3 p) {
+	Light *light = info->light;
+	if (Spots && info->isSpot && !static_cast<Spotlight *>(light)->inCone(p)) return true;
+
+	glm::vec3 intersectPt, normal;
+	Ray ray = Ray(info->position, glm::normalize(p - info->position));
+	float maxDist = glm::distance(p, info->position);
+
+	SceneObject *&last = light->cachedOccluder();
+	if (last && last->isVisible && last->intersect(ray, intersectPt, normal) && glm::distance(intersectPt, info->position) < maxDist) {
+		Light::countShadowTest(true);
+		return true;
+	}
+	Light::countShadowTest(false);
+
+	return blockedBy(s.planes, ray, maxDist, last) || blockedBy(s.spheres, ray, maxDist, last)
+		|| (Meshes && blockedBy(s.meshes, ray, maxDist, last)) || blockedBy(s.lightObjects, ray, maxDist, last);
+}
+
+// Same as ofApp::shadeHit and ofApp::phong
+//
+template<bool Shadows, bool Spots, bool Textures, bool Meshes>
+static ofColor shade(ofApp *app, const Ray &ray, const HitRecord &hit, Plane *hitPlane) {
+	ofColor diffuse = hit.obj->diffuseColor;
+	if (Textures && hitPlane) diffuse = hitPlane->Plane::getColorAt(hit.point, app->pixelFootprint(ray, hit));
+	ofColor specular = hit.obj->specularColor;
+	ofColor result = diffuse * (app->ambientStrength);
+
+	thread_local vector<const LightInfo *> candidates;
+	thread_local vector<LightSample> samples;
+	candidates.clear();
+	samples.clear();
+	app->lightCuller.gatherPointLights(candidates);
+	if (Spots) app->lightCuller.gatherSpotlights(hit.point, candidates);
+	app->weighLights(candidates, hit.point, hit.normal, diffuse, specular, app->phongPower, samples);
+
+	glm::vec3 origin = hit.point + (hit.normal * 0.01);
+	glm::vec3 sum = glm::vec3(0, 0, 0);
+	for (LightSample &s : samples) {
+		if (!Shadows || !occluded<Spots, Meshes>(app->sceneLists, s.light, origin)) sum += s.color;
+	}
+	result += ofColor(min(sum.x, 255.0f), min(sum.y, 255.0f), min(sum.z, 255.0f));
+	return result;
+}
+
+// Same as ofApp::traceRay
+//
+template<bool Shadows, bool Spots, bool Textures, bool Meshes>
+static ofColor traceKernel(ofApp *app, const Ray &ray, SceneObject *&hitObj) {
+	HitRecord hit;
+	Plane *hitPlane;
+	if (!closestHit<Textures, Meshes>(app->sceneLists, ray, hit, hitPlane)) {
+		hitObj = NULL;
+		return ofColor::darkGray;
+	}
+	hitObj = hit.obj;
+	return shade<Shadows, Spots, Textures, Meshes>(app, ray, hit, hitPlane);
+}
+
+// Same as ofApp::renderTile
+//
+template<bool Shadows, bool Spots, bool Textures, bool Meshes>
+static void tileKernel(ofApp *app, int x0, int y0, int x1, int y1) {
+	TRACE_SCOPE_ARGS("tile", "render", "\"x\":" + ofToString(x0) + ",\"y\":" + ofToString(y0));
+
+	int width = app->imageWidth;
+	int height = app->imageHeight;
+	for (int i = x0; i < x1; i++) {
+		for (int j = y0; j < y1; j++) {
+			Ray ray = app->renderCam.getRay((i + 0.5) / width, (j + 0.5) / height);
+			SceneObject *hitObj;
+			ofColor color = traceKernel<Shadows, Spots, Textures, Meshes>(app, ray, hitObj);
+
+			app->storeBasePixel(i, j, color, hitObj);
+		}
+	}
+}
+
+template<bool Shadows, bool Spots, bool Textures, bool Meshes>
+static RenderKernels makeKernels() {
+	RenderKernels k;
+	k.tile = tileKernel<Shadows, Spots, Textures, Meshes>;
+	k.ray = traceKernel<Shadows, Spots, Textures, Meshes>;
+	k.name = string(Shadows ? "shadows" : "no shadows") + (Spots ? ", spotlights" : "") + (Textures ? ", textures" : "") + (Meshes ? ", meshes" : "");
+	return k;
+}
+
+// Returns empty kernels (use the general tracer) if the scene has objects the kernels can't handle
+//
+RenderKernels selectKernels(const SceneLists &lists, bool shadows) {
+	if (lists.hasOthers) return RenderKernels();
+
+	static const RenderKernels table[16] = {
+		makeKernels<false, false, false, false>(), makeKernels<false, false, false, true>(),
+		makeKernels<false, false, true, false>(), makeKernels<false, false, true, true>(),
+		makeKernels<false, true, false, false>(), makeKernels<false, true, false, true>(),
+		makeKernels<false, true, true, false>(), makeKernels<false, true, true, true>(),
+		makeKernels<true, false, false, false>(), makeKernels<true, false, false, true>(),
+		makeKernels<true, false, true, false>(), makeKernels<true, false, true, true>(),
+		makeKernels<true, true, false, false>(), makeKernels<true, true, false, true>(),
+		makeKernels<true, true, true, false>(), makeKernels<true, true, true, true>(),
+	};
+	int index = (shadows ? 8 : 0) + (lists.hasSpotlights ? 4 : 0) + (lists.hasTexturedPlanes ? 2 : 0) + (lists.meshes.empty() ? 0 : 1);
+	return table[index];
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Shapes.h"
+#include "Mesh.h"
+#include "Lights.h"
+
+// Render kernels specialized at compile time for the features a scene uses.
+// The general tracer calls intersect(), getColorAt() and isBlocked() through virtual functions on every object,
+// and tests for textures, spotlights and shadows per ray. Before a render the scene's visible objects are split
+// into one list per type, and a kernel is picked that was compiled for exactly the features present: with no
+// meshes the mesh loop doesn't exist, with no textures the diffuse color is read directly, and so on.
+// Every call inside a kernel is to a known type, so it's a direct call instead of a virtual one. The intersection
+// tests themselves live in Shapes.cpp and Mesh.cpp, so they're only inlined into the kernels with link-time
+// optimization; the gain without it is the dispatch and the per-ray feature tests that are compiled out.
+
+class ofApp;
+
+//  The visible scene objects for one render, split by exact type
+//
+struct SceneLists {
+	vector<Plane *> planes;
+	vector<Sphere *> spheres;
+	vector<Mesh *> meshes;
+	vector<Light *> lightObjects;		// lights drawn in the scene can be hit by rays too
+
+	bool hasTexturedPlanes = false;
+	bool hasSpotlights = false;
+	bool hasOthers = false;				// an object of a type the kernels don't know about; use the general tracer
+
+	void build(const vector<SceneObject *> &scene, const vector<Light *> &lights);
+	size_t getMemoryUsage() {
+		return (planes.capacity() + spheres.capacity() + meshes.capacity() + lightObjects.capacity()) * sizeof(void *);
+	}
+};
+
+typedef void (*TileKernel)(ofApp *app, int x0, int y0, int x1, int y1);
+typedef ofColor (*RayKernel)(ofApp *app, const Ray &ray, SceneObject *&hitObj);
+
+//  The pair of kernels compiled for one combination of features
+//
+struct RenderKernels {
+	TileKernel tile = NULL;			// base pass: one ray through the center of each pixel of a tile
+	RayKernel ray = NULL;			// a single ray, for anti-aliasing samples
+	string name;
+};
+
+// Choose the kernels for the scene in lists, with or without shadows
+RenderKernels selectKernels(const SceneLists &lists, bool shadows);
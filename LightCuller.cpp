@@ -0,0 +1,115 @@
+#include "LightCuller.h"
+
+static const int leafSize = 4;
+
+// Snapshot the lights for this render and build the spotlight hierarchy. Lights with no power are dropped.
+//
+void LightCuller::build(const vector<Light *> &lights, float falloff) {
+	infos.clear();
+	pointIndices.clear();
+	spotIndices.clear();
+	nodes.clear();
+
+	for (Light *l : lights) {
+		l->prepare();
+		LightInfo info;
+		info.light = l;
+		info.position = l->position;
+		info.power = l->intensity / falloff;
+		if (info.power <= 0) continue;
+
+		Spotlight *spot = dynamic_cast<Spotlight *>(l);
+		if (spot) {
+			info.isSpot = true;
+			info.direction = spot->unitDirection;
+			info.cosCutoff = spot->cosAngle;
+			info.halfAngle = glm::radians((float)spot->angle);
+		}
+		infos.push_back(info);
+	}
+
+	for (int i = 0; i < infos.size(); i++) {
+		if (infos[i].isSpot) spotIndices.push_back(i);
+		else pointIndices.push_back(i);
+	}
+	if (!spotIndices.empty()) buildNode(0, spotIndices.size());
+}
+
+// Bound the spotlights in spotIndices[first, first + count), then split them at the median of the longest axis
+//
+int LightCuller::buildNode(int first, int count) {
+	Node node;
+	node.first = first;
+	node.count = count;
+
+	glm::vec3 lo = infos[spotIndices[first]].position;
+	glm::vec3 hi = lo;
+	glm::vec3 axisSum = glm::vec3(0, 0, 0);
+	for (int k = first; k < first + count; k++) {
+		LightInfo &info = infos[spotIndices[k]];
+		lo = glm::min(lo, info.position);
+		hi = glm::max(hi, info.position);
+		axisSum += info.direction;
+	}
+	node.center = (lo + hi) / 2;
+	node.radius = glm::length(hi - lo) / 2;
+	node.axis = (glm::length(axisSum) > 0.0001) ? glm::normalize(axisSum) : infos[spotIndices[first]].direction;
+	node.coneAngle = 0;
+	for (int k = first; k < first + count; k++) {
+		LightInfo &info = infos[spotIndices[k]];
+		float spread = acos(glm::clamp(glm::dot(node.axis, info.direction), -1.0f, 1.0f)) + info.halfAngle;
+		node.coneAngle = max(node.coneAngle, spread);
+	}
+
+	int index = nodes.size();
+	nodes.push_back(node);
+	if (count > leafSize) {
+		glm::vec3 extent = hi - lo;
+		int dim = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+		int mid = first + count / 2;
+		std::nth_element(spotIndices.begin() + first, spotIndices.begin() + mid, spotIndices.begin() + first + count,
+			[this, dim](int a, int b) { return infos[a].position[dim] < infos[b].position[dim]; });
+		int left = buildNode(first, mid - first);
+		int right = buildNode(mid, first + count - mid);
+		nodes[index].left = left;		// nodes may have been reallocated by the recursive calls
+		nodes[index].right = right;
+	}
+	return index;
+}
+
+void LightCuller::gather(glm::vec3 p, vector<const LightInfo *> &result) {
+	gatherPointLights(result);
+	gatherSpotlights(p, result);
+}
+
+void LightCuller::gatherPointLights(vector<const LightInfo *> &result) {
+	for (int i : pointIndices) result.push_back(&infos[i]);
+}
+
+void LightCuller::gatherSpotlights(glm::vec3 p, vector<const LightInfo *> &result) {
+	if (!nodes.empty()) gatherNode(0, p, result);
+}
+
+// A node is skipped when the directions from its bounding sphere to p all fall outside its bounding cone
+//
+void LightCuller::gatherNode(int n, glm::vec3 p, vector<const LightInfo *> &result) {
+	const Node &node = nodes[n];
+	if (node.coneAngle < PI) {
+		glm::vec3 d = p - node.center;
+		float dist = glm::length(d);
+		if (dist > node.radius) {
+			float angle = acos(glm::clamp(glm::dot(node.axis, d) / dist, -1.0f, 1.0f));
+			if (angle - asin(node.radius / dist) > node.coneAngle) return;
+		}
+	}
+
+	if (node.left < 0) {
+		for (int k = node.first; k < node.first + node.count; k++) {
+			const LightInfo &info = infos[spotIndices[k]];
+			if (glm::dot(info.direction, glm::normalize(p - info.position)) >= info.cosCutoff) result.push_back(&info);
+		}
+		return;
+	}
+	gatherNode(node.left, p, result);
+	gatherNode(node.right, p, result);
+}
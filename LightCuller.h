@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Lights.h"
+
+// Acceleration structure for shading with many lights.
+// Before each render, the lights' settings are snapshotted and the spotlights are sorted into a small
+// bounding volume hierarchy where every node stores a box around its lights and a cone around their beams.
+// For a shaded point, whole subtrees whose beams can't reach the point are skipped, so only lights
+// that can possibly illuminate it are handed back to have a shadow ray cast.
+
+struct LightInfo {
+	Light *light;
+	glm::vec3 position;
+	glm::vec3 direction;		// unit beam direction, spotlights only
+	float cosCutoff = -1;		// cosine of the cone angle, spotlights only
+	float halfAngle = 0;		// cone angle in radians, spotlights only
+	float power;				// intensity / falloff
+	bool isSpot = false;
+};
+
+// A light chosen for a shadow ray, and the color it adds if the ray isn't blocked
+//
+struct LightSample {
+	const LightInfo *light;
+	glm::vec3 color;
+};
+
+//  Light hierarchy with cone culling
+//
+class LightCuller {
+public:
+	void build(const vector<Light *> &lights, float falloff);
+
+	// append every light that may reach point p (ignoring shadows) to result
+	void gather(glm::vec3 p, vector<const LightInfo *> &result);
+
+	// the two halves of gather(), for callers that already know whether the scene has spotlights
+	void gatherPointLights(vector<const LightInfo *> &result);
+	void gatherSpotlights(glm::vec3 p, vector<const LightInfo *> &result);
+
+	int getNumLights() { return infos.size(); }
+	size_t getMemoryUsage() {
+		return infos.capacity() * sizeof(LightInfo) + (pointIndices.capacity() + spotIndices.capacity()) * sizeof(int) + nodes.capacity() * sizeof(Node);
+	}
+
+private:
+	struct Node {
+		glm::vec3 center;		// bounding sphere of the light positions
+		float radius;
+		glm::vec3 axis;			// bounding cone of all the beams below this node
+		float coneAngle;
+		int first, count;		// range in spotIndices (leaves only)
+		int left = -1, right = -1;
+	};
+
+	int buildNode(int first, int count);
+	void gatherNode(int n, glm::vec3 p, vector<const LightInfo *> &result);
+
+	vector<LightInfo> infos;
+	vector<int> pointIndices;	// point lights shine everywhere, so they are always candidates
+	vector<int> spotIndices;
+	vector<Node> nodes;
+};
@@ -1,26 +1,96 @@
 #include "Lights.h"
+#include <atomic>
 
-// Checks if the line segment between the given point and the light is blocked by any of the given SceneObjects
+// Occluder cache for the calling thread. The generation number lets resetShadowCache() invalidate
+// every thread's cache at once, since cached objects may have been deleted between renders.
 //
-bool Light::isBlocked(glm::vec3 surfacePoint, vector<SceneObject *> sceneObjs) {
-	glm::vec3 intersectPt, normal;
-	Ray ray = Ray(position, glm::normalize(surfacePoint - position));
-	for (SceneObject *obj : sceneObjs) {
-		if (obj->isVisible && obj->intersect(ray, intersectPt, normal) && glm::distance(intersectPt, position) < glm::distance(surfacePoint, position)) return true;
+struct OccluderCache {
+	int generation = -1;
+	uint64_t tests = 0;
+	uint64_t hits = 0;
+	unordered_map<const Light *, SceneObject *> lastOccluder;
+};
+
+static std::atomic<int> cacheGeneration(0);
+static std::atomic<uint64_t> totalTests(0);
+static std::atomic<uint64_t> totalHits(0);
+
+static OccluderCache &threadCache() {
+	thread_local OccluderCache cache;
+	if (cache.generation != cacheGeneration) {
+		cache.lastOccluder.clear();
+		cache.tests = cache.hits = 0;
+		cache.generation = cacheGeneration;
 	}
-	return false;
+	return cache;
+}
+
+void Light::resetShadowCache() {
+	cacheGeneration++;
+	totalTests = 0;
+	totalHits = 0;
+}
+
+// Add this thread's counts to the totals; counting per thread keeps atomics out of the shadow test itself
+//
+void Light::flushShadowCacheStats() {
+	OccluderCache &cache = threadCache();
+	totalTests += cache.tests;
+	totalHits += cache.hits;
+	cache.tests = cache.hits = 0;
+}
+
+void Light::getShadowCacheStats(uint64_t &tests, uint64_t &hits) {
+	tests = totalTests;
+	hits = totalHits;
+}
+
+SceneObject *&Light::cachedOccluder() {
+	return threadCache().lastOccluder[this];
+}
+
+void Light::countShadowTest(bool cacheHit) {
+	OccluderCache &cache = threadCache();
+	cache.tests++;
+	if (cacheHit) cache.hits++;
+}
+
+// Checks if the line segment between the given point and the light is blocked by any of the given SceneObjects
+//
+bool Light::isBlocked(glm::vec3 surfacePoint, const vector<SceneObject *> &sceneObjs) {
+	return segmentBlocked(surfacePoint, sceneObjs);
 }
 
 // Checks if the line segment between the given point and the spotlight is blocked by any of the given SceneObjects or is outside the light cone
+// (the cone test compares against the cosine cached by prepare(), so it needs no acos)
 //
-bool Spotlight::isBlocked(glm::vec3 surfacePoint, vector<SceneObject *> sceneObjs) {
+bool Spotlight::isBlocked(glm::vec3 surfacePoint, const vector<SceneObject *> &sceneObjs) {
+	if (!inCone(surfacePoint)) return true;
+	return segmentBlocked(surfacePoint, sceneObjs);
+}
+
+// Shadow test shared by both kinds of light. The last occluder this thread found for the light is tried first,
+// since neighboring points usually share a blocker; only if it misses are the rest of the objects tested.
+//
+bool Light::segmentBlocked(glm::vec3 surfacePoint, const vector<SceneObject *> &sceneObjs) {
 	glm::vec3 intersectPt, normal;
-	glm::vec3 dir = direction;
-	float ang = angle;
 	Ray ray = Ray(position, glm::normalize(surfacePoint - position));
-	if (glm::angle(glm::normalize(dir), glm::normalize(surfacePoint - position)) > glm::radians(ang)) return true;
+	float maxDist = glm::distance(surfacePoint, position);
+
+	OccluderCache &cache = threadCache();
+	SceneObject *&last = cache.lastOccluder[this];
+	cache.tests++;
+	if (last && last->isVisible && last->intersect(ray, intersectPt, normal) && glm::distance(intersectPt, position) < maxDist) {
+		cache.hits++;
+		return true;
+	}
+
 	for (SceneObject *obj : sceneObjs) {
-		if (obj->isVisible && obj->intersect(ray, intersectPt, normal) && glm::distance(intersectPt, position) < glm::distance(surfacePoint, position)) return true;
+		if (obj == last) continue;		// already tested above
+		if (obj->isVisible && obj->intersect(ray, intersectPt, normal) && glm::distance(intersectPt, position) < maxDist) {
+			last = obj;
+			return true;
+		}
 	}
 	return false;
-}
+}
@@ -31,12 +31,37 @@ public:
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
 		return (glm::intersectRaySphere(ray.p, ray.d, position, 0.3, point, normal));
 	}
+	bool getBounds(glm::vec3 &lo, glm::vec3 &hi) {
+		lo = position - glm::vec3(0.3);
+		hi = position + glm::vec3(0.3);
+		return true;
+	}
+
 
 
+	virtual void prepare() {}	// cache anything derived from the settings before a render
+	uint64_t getSignature() {
+		uint64_t h = SceneObject::getSignature();
+		hashValue(h, (float)intensity);
+		return h;
+	}
+	virtual bool isBlocked(glm::vec3, const vector<SceneObject *> &);
+
+	// Each render thread remembers the last object that blocked each light and tests it first.
+	// Call resetShadowCache() before a render, and flushShadowCacheStats() as each render thread finishes.
+	static void resetShadowCache();
+	static void flushShadowCacheStats();
+	static void getShadowCacheStats(uint64_t &tests, uint64_t &hits);
 
-	virtual bool isBlocked(glm::vec3, vector<SceneObject *>);
+	// for shadow tests done outside segmentBlocked() (see Kernels.h): this light's entry in the calling thread's cache,
+	// and counting a test in the stats
+	SceneObject *&cachedOccluder();
+	static void countShadowTest(bool cacheHit);
 
 	ofxFloatSlider intensity;
+
+protected:
+	bool segmentBlocked(glm::vec3, const vector<SceneObject *> &);
 };
 
 //	A directional light source that projects its light in a cone
@@ -70,8 +95,22 @@ public:
 
 	//void setDirection(glm::vec3 newDir) { direction = glm::normalize(newDir); }
 
-	bool isBlocked(glm::vec3, vector<SceneObject *>);
+	void prepare() {
+		unitDirection = glm::normalize((glm::vec3)direction);
+		cosAngle = cos(glm::radians((float)angle));
+	}
+	uint64_t getSignature() {
+		uint64_t h = Light::getSignature();
+		hashValue(h, (glm::vec3)direction);
+		hashValue(h, (float)angle);
+		return h;
+	}
+	bool inCone(glm::vec3 surfacePoint) { return glm::dot(unitDirection, glm::normalize(surfacePoint - position)) >= cosAngle; }
+	bool isBlocked(glm::vec3, const vector<SceneObject *> &);
 
 	ofxVec3Slider direction;
 	ofxFloatSlider angle;
+
+	glm::vec3 unitDirection = glm::vec3(0, -1, 0);	// set by prepare()
+	float cosAngle = 1;
 };
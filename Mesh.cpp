@@ -1,75 +1,55 @@
 #include "Mesh.h"
+#include "Tracer.h"
+#include "Simplify.h"
 
 
-// Ray box intersection function, as defined in:
-//		Amy Williams, Steve Barrus, R.Keith Morley, and Peter Shirley 
-//		"An Efficient and Robust Ray-Box Intersection Algorithm" 
-//		Journal of graphics tools, 10(1) : 49 - 54, 2005
-//
-bool intersectRayBox(const Ray &r, float minDist, float maxDist, glm::vec3 bottomCorner, glm::vec3 topCorner) {
-	float tmin, tmax, tymin, tymax, tzmin, tzmax;
-	glm::vec3 boundingBox[2] = { bottomCorner, topCorner };
-
-	tmin = (boundingBox[r.sign[0]].x - r.p.x) * r.inv_d.x;
-	tmax = (boundingBox[1 - r.sign[0]].x - r.p.x) * r.inv_d.x;
-	tymin = (boundingBox[r.sign[1]].y - r.p.y) * r.inv_d.y;
-	tymax = (boundingBox[1 - r.sign[1]].y - r.p.y) * r.inv_d.y;
-	if ((tmin > tymax) || (tymin > tmax))
-		return false;
-	if (tymin > tmin)
-		tmin = tymin;
-	if (tymax < tmax)
-		tmax = tymax;
-	tzmin = (boundingBox[r.sign[2]].z - r.p.z) * r.inv_d.z;
-	tzmax = (boundingBox[1 - r.sign[2]].z - r.p.z) * r.inv_d.z;
-	if ((tmin > tzmax) || (tzmin > tmax))
-		return false;
-	if (tzmin > tmin)
-		tmin = tzmin;
-	if (tzmax < tmax)
-		tmax = tzmax;
-	return ((tmin < maxDist) && (tmax > minDist));
-}
-
 // takes in an obj file and parses it into its vertices and faces. the mesh is cleared and refilled with the new vertices and triangles
 //
 void Mesh::readObjFile(string fileName) {
+	TRACE_SCOPE("readObjFile", "load");
 	clearMesh();
 
 	FILE *file;
 	char s[64];
 
 	file = fopen(fileName.c_str(), "r");
+	if (file == NULL) {
+		cout << "can't open " << fileName << endl;
+		return;
+	}
 
 	float x, y, z;
 	int i, j, k;
 
-	while (fscanf(file, "%s", s) != EOF) {
-		if (s[0] == 'v' && strlen(s) == 1) {		// vertex data: read the next 3 values as floats
-			fscanf(file, "%s", s);
-			x = stringToFloat(s);
-			fscanf(file, "%s", s);
-			y = stringToFloat(s);
-			fscanf(file, "%s", s);
-			z = stringToFloat(s);
-			addVertex(x, y, z);
-		}
-		else if (s[0] == 'f'  && strlen(s) == 1) {	// face (index) data: read the next 3 values as ints
-			fscanf(file, "%s", s);
-			i = reformatFaceData(s) - 1;	// -1 because it seems like .obj files don't follow the "start counting from 0" rule
-			fscanf(file, "%s", s);
-			j = reformatFaceData(s) - 1;
-			fscanf(file, "%s", s);
-			k = reformatFaceData(s) - 1;
-			addTriangle(i, j, k);
-		}
-	}
+	{
+		TRACE_SCOPE("parse obj", "load");
+		while (fscanf(file, "%s", s) != EOF) {
+			if (s[0] == 'v' && strlen(s) == 1) {		// vertex data: read the next 3 values as floats
+				fscanf(file, "%s", s);
+				x = stringToFloat(s);
+				fscanf(file, "%s", s);
+				y = stringToFloat(s);
+				fscanf(file, "%s", s);
+				z = stringToFloat(s);
+				addVertex(x, y, z);
+			}
+			else if (s[0] == 'f'  && strlen(s) == 1) {	// face (index) data: read the next 3 values as ints
+				fscanf(file, "%s", s);
+				i = reformatFaceData(s) - 1;	// -1 because it seems like .obj files don't follow the "start counting from 0" rule
+				fscanf(file, "%s", s);
+				j = reformatFaceData(s) - 1;
+				fscanf(file, "%s", s);
+				k = reformatFaceData(s) - 1;
+				addTriangle(i, j, k);
+			}
+		}
+	}
 
 	cout << "vertices: " << verts.size() << endl;
 	cout << "triangles: " << triangles.size() << endl;
-	cout << "size: " << sizeof(this) << "kB" << endl;
 
 	fclose(file);
+	if (verts.empty()) return;
 
 	// make a bounding box so we can find the center of the points
 	topCorner = bottomCorner = verts.front();
@@ -87,51 +67,96 @@ void Mesh::readObjFile(string fileName) {
 	for (int i = 0; i < verts.size(); i++) {
 		verts[i] -= center;			// recenter the relative origin of the mesh to the center of the points, so that it doesn't look weird when scaling
 	}
-	bottomCorner -= center;
-	topCorner -= center;
-
-	// create the face normals of all the triangles
-	for (int i = 0; i < triangles.size(); i++) {				
-		triangles[i].normal = glm::normalize(glm::cross(
-			(transform(verts[triangles[i].vInd[1]]) - transform(verts[triangles[i].vInd[0]])),
-			(transform(verts[triangles[i].vInd[2]]) - transform(verts[triangles[i].vInd[0]]))
-		));
-
-	}
-
-	// create the vertex normals for each vertex
-	for (int i = 0; i < verts.size(); i++) {					
-		int count = 0;
-		glm::vec3 avg = glm::vec3(0, 0, 0);
-
-		for (Tri t : triangles) {		// ...yes, this is a very slow algorthm
-			if (t.vInd[0] == i || t.vInd[1] == i || t.vInd[2] == i) {
-				count++;
-				avg += t.normal;
-			}
-			
-		}
-
-		avg.x = avg.x / count;
-		avg.y = avg.y / count;
-		avg.z = avg.z / count;
-		avg = glm::normalize(avg);
-
-		vertNormals.push_back(avg);		// vertex i's normal can be found at vertNormals[i]
-	}
-
+	prepareGeometry();
+}
+
+// Work out everything derived from verts and triangles as they are: the bounding box, normals, BVH and levels of
+// detail. Used after reading a file and when a mesh's geometry arrives from somewhere else.
+//
+void Mesh::prepareGeometry() {
+	if (verts.empty()) return;
+	topCorner = bottomCorner = verts.front();
+	for (const glm::vec3 &v : verts) {
+		topCorner = glm::max(topCorner, v);
+		bottomCorner = glm::min(bottomCorner, v);
+	}
+	boundRadius = glm::length(topCorner - bottomCorner) / 2;
+
+	{
+		TRACE_SCOPE("generate normals", "load");
+		computeNormals(verts, triangles, vertNormals);	// vertex i's normal can be found at vertNormals[i]
+	}
+	{
+		TRACE_SCOPE("build BVH", "load");
+		shared_ptr<TriangleBVH> built = make_shared<TriangleBVH>();
+		built->build(verts, triangles);
+		bvh = built;
+	}
+	buildLods();
+	geometryChanged();
+	cout << "size: " << getMemoryUsage() / 1024 << "kB" << endl;
 }
 
-// intersect ray with the mesh; checks a bounding box first, then each triangle
+// Build the level of detail chain: each level has about half the triangles of the one before, until the mesh gets
+// down to minLodTriangles or stops getting much smaller. Errors add up, since every level simplifies the last.
 //
-bool Mesh::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &norm) {
-	if (!intersectRayBox(ray, 0, 1000, bottomCorner, topCorner)) return false;
+void Mesh::buildLods() {
+	TRACE_SCOPE("build LODs", "load");
+	shared_ptr<vector<MeshLevel>> levels = make_shared<vector<MeshLevel>>();
+	activeLod = 0;
+	const vector<glm::vec3> *prevVerts = &verts;
+	const vector<Tri> *prevTris = &triangles;
+	float error = 0;
+	while (prevTris->size() / 2 >= minLodTriangles) {
+		MeshLevel level;
+		error += simplifyMesh(*prevVerts, *prevTris, prevTris->size() / 2, level.verts, level.triangles);
+		if (level.triangles.size() > prevTris->size() * 0.9) break;		// stuck on borders or flips
+		level.error = error;
+		computeNormals(level.verts, level.triangles, level.vertNormals);
+		level.bvh.build(level.verts, level.triangles);
+		levels->push_back(std::move(level));
+		prevVerts = &levels->back().verts;
+		prevTris = &levels->back().triangles;
+	}
+	lods = levels;
+
+	cout << "levels of detail: " << triangles.size();
+	for (MeshLevel &l : *levels) cout << ", " << l.triangles.size();
+	cout << " triangles" << endl;
+}
+
+// Pick the level for a render from eye. The distance is to the nearest point of the bounding sphere, so the level
+// is never too coarse for the closest part of the mesh. The level is chosen once per render rather than per ray,
+// so primary and shadow rays always see the same surface.
+//
+void Mesh::selectLod(glm::vec3 eye, float errorPerDistance) {
+	activeLod = 0;
+	float dist = glm::distance(eye, position) - boundRadius * scale;
+	if (dist <= 0 || errorPerDistance <= 0 || !lods) return;
+	float allowed = dist * errorPerDistance / scale;		// in the mesh's own units
+	for (int i = 0; i < lods->size(); i++) {
+		if ((*lods)[i].error <= allowed) activeLod = i + 1;
+	}
+}
+
+// intersect ray with level lod of the mesh; walks the triangle BVH in local space, then tests the triangles it reaches in world
+// space. The local ray's direction is scaled along with its origin, so distances along it match the world ray's.
+//
+bool Mesh::intersectLevel(const Ray &ray, glm::vec3 &point, glm::vec3 &norm, int lod) {
 	Ray r = ray;
+	Ray local = Ray(inverseRotate(ray.p - position) / (float)scale, inverseRotate(ray.d) / (float)scale);
 	glm::vec2 bary, closestBary;
 	glm::vec3 closestNorm, vn0, vn1, vn2;	// face normal and vertex normals of the closest triangle
 	float dist;
 	float closest = 1000;
-	for (Tri t : triangles) {
+	const MeshLevel *level = (lod && lods) ? &(*lods)[lod - 1] : NULL;
+	if (!level && !this->bvh) return false;		// not prepared
+	const vector<glm::vec3> &verts = level ? level->verts : this->verts;
+	const vector<glm::vec3> &vertNormals = level ? level->vertNormals : this->vertNormals;
+	const vector<Tri> &triangles = level ? level->triangles : this->triangles;
+	const TriangleBVH &bvh = level ? level->bvh : *this->bvh;
+	bvh.traverse(local, closest, [&](int index) {
+		const Tri &t = triangles[index];
 		if (glm::intersectRayTriangle(r.p, r.d, transform(verts[t.vInd[0]]), transform(verts[t.vInd[1]]), transform(verts[t.vInd[2]]), bary, dist) && dist < closest) {
 			closest = dist;
 			point = r.evalPoint(closest);
@@ -141,7 +166,7 @@ bool Mesh::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &norm) {
 			vn1 = vertNormals[t.vInd[1]];
 			vn2 = vertNormals[t.vInd[2]];
 		}
-	}
+	});
 
 	norm = (1 - closestBary.x - closestBary.y) * vn0 + closestBary.x * vn1 + closestBary.y * vn2;	// linearly interpolate hit-point normals using vertex normals multiplied by barycentric coordinates
 
@@ -155,32 +180,62 @@ bool Mesh::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &norm) {
 	return false;
 }
 
-// draw the entire mesh as a wireframe using ofDrawTriangle()
+// World-space box around the mesh: the local bounding box's corners, transformed. Kept until the mesh moves.
 //
-void Mesh::draw() {
-	topCorner = bottomCorner = transform(verts.front());
-	for (auto vertex : verts) {
-	glm::vec3 v = transform(vertex);
-		if (v.x > topCorner.x) topCorner.x = v.x;
-		if (v.y > topCorner.y) topCorner.y = v.y;
-		if (v.z > topCorner.z) topCorner.z = v.z;
-		if (v.x < bottomCorner.x) bottomCorner.x = v.x;
-		if (v.y < bottomCorner.y) bottomCorner.y = v.y;
-		if (v.z < bottomCorner.z) bottomCorner.z = v.z;
+bool Mesh::getBounds(glm::vec3 &lo, glm::vec3 &hi) {
+	if (verts.empty()) return false;
+	uint64_t key = 14695981039346656037ull;
+	hashValue(key, position);
+	hashValue(key, (float)scale);
+	hashValue(key, (glm::vec3)rotation);
+	if (key != boundsKey) {
+		boundsLo = boundsHi = transform(bottomCorner);
+		for (int c = 1; c < 8; c++) {
+			glm::vec3 corner = transform(glm::vec3((c & 1) ? topCorner.x : bottomCorner.x, (c & 2) ? topCorner.y : bottomCorner.y, (c & 4) ? topCorner.z : bottomCorner.z));
+			boundsLo = glm::min(boundsLo, corner);
+			boundsHi = glm::max(boundsHi, corner);
+		}
+		boundsKey = key;
 	}
-	
-	vector<Tri> selectedTris;
-	float size = scale;
-	for (auto t : triangles) {
-		ofDrawTriangle(transform(verts[t.vInd[0]]), transform(verts[t.vInd[1]]), transform(verts[t.vInd[2]]));
+	lo = boundsLo;
+	hi = boundsHi;
+	return true;
+}
+
+// draw the mesh from its vertex buffer, filling it first if the geometry changed, under the same transform the
+// ray tracer uses (rotate about x, then y, then z, scale, then move to position), plus its bounding box
+//
+void Mesh::draw() {
+	if (verts.empty()) return;
+	if (vboDirty) {
+		vector<ofIndexType> indices;
+		indices.reserve(triangles.size() * 3);
+		for (const Tri &t : triangles) {
+			for (int k = 0; k < 3; k++) indices.push_back(t.vInd[k]);
+		}
+		vboMesh.clear();
+		vboMesh.setMode(OF_PRIMITIVE_TRIANGLES);
+		vboMesh.setUsage(GL_STATIC_DRAW);
+		vboMesh.addVertices(verts);
+		vboMesh.addIndices(indices);
+		vboDirty = false;
 	}
 
+	glm::vec3 rot = rotation;
+	ofPushMatrix();
+	ofTranslate(position);
+	ofRotateZDeg(rot.z);
+	ofRotateYDeg(rot.y);
+	ofRotateXDeg(rot.x);
+	ofScale(scale, scale, scale);
+	if (ofGetFill() == OF_FILLED) vboMesh.draw();
+	else vboMesh.drawWireframe();
+	ofPopMatrix();
+
+	glm::vec3 lo, hi;
+	getBounds(lo, hi);
 	ofNoFill();
-	glm::vec3 center = bottomCorner + (topCorner - bottomCorner) / 2;
-	ofDrawBox(center, topCorner.x - bottomCorner.x, topCorner.y - bottomCorner.y, topCorner.z - bottomCorner.z);
+	glm::vec3 center = lo + (hi - lo) / 2;
+	ofDrawBox(center, hi.x - lo.x, hi.y - lo.y, hi.z - lo.z);
 	ofFill();
 }
-
-
-
-
@@ -1,10 +1,15 @@
 #pragma once
 
 #include "SceneObject.h"
+#include "MeshBVH.h"
 
 // A class to handle .obj meshes by rpocessing them into vectors of vertices and triangles with indices.
 // Allows for intersection with a ray and drawing in the openframeworks window.
 // Maintains a bounding box to help speed up ray intersection.
+// For the editor view the triangles are uploaded once to a vertex buffer on the GPU and drawn under a model matrix,
+// so drawing doesn't touch the vertices on the CPU every frame; the upload is redone only when the geometry changes.
+// On import a chain of simplified copies is built (see Simplify.h); before each render the coarsest copy whose
+// error would still be smaller than the allowed number of pixels from the camera is picked for ray intersection.
 
 class Tri {
 public:
@@ -14,6 +19,16 @@ public:
 	glm::vec3 normal;
 };
 
+//  One level of detail of a mesh: a simplified copy and how far at most it strays from the original
+//
+struct MeshLevel {
+	vector<glm::vec3> verts;
+	vector<glm::vec3> vertNormals;
+	vector<Tri> triangles;
+	TriangleBVH bvh;
+	float error = 0;		// in the mesh's units, before scaling
+};
+
 //  Mesh class, imported from project 1
 //
 class Mesh : public SceneObject {
@@ -48,7 +63,35 @@ private:
 		return result;
 	}
 
+	// undo transform's rotation, for taking rays into the mesh's local space
+	glm::vec3 inverseRotate(glm::vec3 v) {
+		glm::vec3 rot = rotation;
+		v = glm::rotateZ(v, glm::radians(-rot.z));
+		v = glm::rotateY(v, glm::radians(-rot.y));
+		v = glm::rotateX(v, glm::radians(-rot.x));
+		return v;
+	}
+
 	glm::vec3 topCorner, bottomCorner;			// used to create a bounding box for the mesh to speed up ray intersection a little bit.
+	float boundRadius = 0;						// half the diagonal of the untransformed bounding box
+
+	// built by prepareGeometry() and never changed after, so meshes with the same geometry share them
+	shared_ptr<const TriangleBVH> bvh;				// over triangles, in local space
+	// coarser and coarser copies; level 0 is the mesh itself. Level 0 stays resident for drawing, editing and sending
+	// the scene, so with each level about half the last the chain costs about the mesh's size again in memory.
+	shared_ptr<const vector<MeshLevel>> lods;
+	int activeLod = 0;		// chosen by selectLod() for the renders from one eye; only intersect() uses it
+
+	ofVboMesh vboMesh;			// level 0's triangles in local space, for draw()
+	bool vboDirty = true;		// geometry changed since vboMesh was filled
+	glm::vec3 boundsLo, boundsHi;	// world-space box from getBounds()...
+	uint64_t boundsKey = 0;			// ...and the transform it was computed for, 0 if none
+
+	void geometryChanged() {
+		version++;
+		vboDirty = true;
+		boundsKey = 0;
+	}
 
 public:
 	Mesh(glm::vec3 pos) {
@@ -62,20 +105,68 @@ public:
 	vector<glm::vec3> verts;
 	vector<glm::vec3> vertNormals;
 	vector<Tri> triangles;
-	void addVertex(float x, float y, float z) { verts.push_back(glm::vec3(x, y, z)); }
-	void addVertex(glm::vec3 v) { verts.push_back(v); }
-	void addTriangle(int i, int j, int k) { triangles.push_back(Tri(i, j, k)); }
-	void addTriangle(Tri t) { triangles.push_back(t); }
+	void addVertex(float x, float y, float z) { verts.push_back(glm::vec3(x, y, z)); geometryChanged(); }
+	void addVertex(glm::vec3 v) { verts.push_back(v); geometryChanged(); }
+	void addTriangle(int i, int j, int k) { triangles.push_back(Tri(i, j, k)); geometryChanged(); }
+	void addTriangle(Tri t) { triangles.push_back(t); geometryChanged(); }
 	int getNumVertices() { return verts.size(); }
 	glm::vec3 getVertex(int index) { return transform(verts[index]); }
 	void clearMesh() {
 		verts.clear();
+		vertNormals.clear();
 		triangles.clear();
+		bvh.reset();
+		lods.reset();
+		activeLod = 0;
+		geometryChanged();
 	}
 
 
 	void readObjFile(string fileName);
-	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	void prepareGeometry();
+	// Take another mesh's geometry along with everything prepareGeometry() built from it, rather than building it again.
+	// The vertices and triangles are copied, since they're this mesh's own to edit; the BVH and levels of detail are shared.
+	void copyGeometry(const Mesh &other) {
+		verts = other.verts;
+		vertNormals = other.vertNormals;
+		triangles = other.triangles;
+		topCorner = other.topCorner;
+		bottomCorner = other.bottomCorner;
+		boundRadius = other.boundRadius;
+		bvh = other.bvh;
+		lods = other.lods;
+		activeLod = 0;
+		geometryChanged();
+	}
+	void buildLods();
+	// Use the coarsest level whose error, seen from eye, covers at most errorPerDistance radians
+	void selectLod(glm::vec3 eye, float errorPerDistance);
+	int getActiveLod() { return activeLod; }
+	int getNumLods() { return (lods ? lods->size() : 0) + 1; }
+	int minLodTriangles = 64;		// don't simplify further than this
+
+	size_t getMemoryUsage() {
+		size_t bytes = verts.capacity() * sizeof(glm::vec3) + vertNormals.capacity() * sizeof(glm::vec3) + triangles.capacity() * sizeof(Tri)
+			+ vboMesh.getNumVertices() * sizeof(glm::vec3) + vboMesh.getNumIndices() * sizeof(ofIndexType);	// the vbo keeps a copy
+		if (bvh) bytes += bvh->getMemoryUsage();		// counted for every mesh sharing it
+		if (!lods) return bytes;
+		for (const MeshLevel &l : *lods) {
+			bytes += (l.verts.capacity() + l.vertNormals.capacity()) * sizeof(glm::vec3) + l.triangles.capacity() * sizeof(Tri)
+				+ l.bvh.getMemoryUsage();
+		}
+		return bytes;
+	}
+	uint64_t getSignature() {
+		uint64_t h = SceneObject::getSignature();
+		hashValue(h, (float)scale);
+		hashValue(h, (glm::vec3)rotation);
+		hashValue(h, verts.size());
+		hashValue(h, triangles.size());
+		return h;
+	}
+	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) { return intersectLevel(ray, point, normal, activeLod); }
+	bool intersectLevel(const Ray &ray, glm::vec3 &point, glm::vec3 &normal, int lod);		// 0 is full detail
+	bool getBounds(glm::vec3 &lo, glm::vec3 &hi);
 	void draw();
 
 	ofxFloatSlider scale;
@@ -0,0 +1,67 @@
+#include "MeshBVH.h"
+#include "Mesh.h"
+
+// Build the tree over tris. Degenerate trees are avoided by splitting at the median center, so the depth stays
+// around log2 of the triangle count no matter how the triangles are spread out.
+//
+void TriangleBVH::build(const vector<glm::vec3> &verts, const vector<Tri> &tris) {
+	vector<glm::vec3> triLo(tris.size()), triHi(tris.size());
+	for (int i = 0; i < tris.size(); i++) {
+		const glm::vec3 &a = verts[tris[i].vInd[0]], &b = verts[tris[i].vInd[1]], &c = verts[tris[i].vInd[2]];
+		triLo[i] = glm::min(a, glm::min(b, c));
+		triHi[i] = glm::max(a, glm::max(b, c));
+	}
+	buildBoxes(triLo, triHi);
+}
+
+// Build the tree over items given only by their boxes, the way build() does over triangles
+//
+void TriangleBVH::buildBoxes(const vector<glm::vec3> &lo, const vector<glm::vec3> &hi) {
+	clear();
+	if (lo.empty()) return;
+
+	vector<glm::vec3> centers(lo.size());
+	order.resize(lo.size());
+	for (int i = 0; i < lo.size(); i++) {
+		centers[i] = (lo[i] + hi[i]) / 2;
+		order[i] = i;
+	}
+	nodes.reserve(2 * lo.size() / leafTriangles + 1);
+	nodes.push_back(BVHNode());
+	buildNode(0, 0, lo.size(), centers, lo, hi);
+}
+
+// Fill in nodes[index] for order[first .. first + count) and recurse into its children
+//
+void TriangleBVH::buildNode(int index, int first, int count, const vector<glm::vec3> &centers, const vector<glm::vec3> &triLo, const vector<glm::vec3> &triHi) {
+	glm::vec3 lo = triLo[order[first]], hi = triHi[order[first]];
+	glm::vec3 centerLo = centers[order[first]], centerHi = centerLo;
+	for (int i = first; i < first + count; i++) {
+		lo = glm::min(lo, triLo[order[i]]);
+		hi = glm::max(hi, triHi[order[i]]);
+		centerLo = glm::min(centerLo, centers[order[i]]);
+		centerHi = glm::max(centerHi, centers[order[i]]);
+	}
+	nodes[index].lo = lo;
+	nodes[index].hi = hi;
+
+	glm::vec3 extent = centerHi - centerLo;
+	if (count <= leafTriangles || (extent.x == 0 && extent.y == 0 && extent.z == 0)) {
+		nodes[index].first = first;
+		nodes[index].count = count;
+		return;
+	}
+
+	int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+	int half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+		[&centers, axis](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+	int left = nodes.size();		// both children are added together so they sit side by side
+	nodes[index].first = left;
+	nodes[index].count = 0;
+	nodes.push_back(BVHNode());
+	nodes.push_back(BVHNode());
+	buildNode(left, first, half, centers, triLo, triHi);
+	buildNode(left + 1, first + half, count - half, centers, triLo, triHi);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Ray.h"
+
+// Bounding volume hierarchy over the triangles of a mesh, in the mesh's local space.
+// Built once per level of detail when the mesh is loaded: the triangles are split in half by their centers along
+// the longest axis until at most leafTriangles are left in a node. A ray walks the tree nearest child first and skips
+// any box that starts farther away than the closest hit so far, so it only tests the few triangles near its path.
+// The same tree can be built over any boxes (out-of-core meshes use it over their chunks), and walked straight out of
+// a file mapping, where the items have already been stored in leaf order.
+
+class Tri;
+
+//  One node of the tree; leaves own a run of the sorted triangle list, inner nodes have two children side by side
+//
+struct BVHNode {
+	glm::vec3 lo, hi;
+	int first;		// leaf: first index in order; inner node: index of the left child (the right one follows it)
+	int count;		// triangles in a leaf, 0 for an inner node
+};
+
+//  Triangle hierarchy
+//
+class TriangleBVH {
+public:
+	void build(const vector<glm::vec3> &verts, const vector<Tri> &tris);
+	void buildBoxes(const vector<glm::vec3> &lo, const vector<glm::vec3> &hi);		// over items with these bounds
+	void clear() { nodes.clear(); order.clear(); }
+	bool isEmpty() const { return nodes.empty(); }
+	size_t getMemoryUsage() const { return nodes.capacity() * sizeof(BVHNode) + order.capacity() * sizeof(int); }
+	const vector<BVHNode> &getNodes() const { return nodes; }
+	const vector<int> &getOrder() const { return order; }		// item indices, grouped by leaf
+
+	// Call hitTriangle(index) for the triangles whose boxes the ray enters before maxDist, nearest boxes first.
+	// hitTriangle lowers maxDist when it finds a closer hit, which prunes the rest of the walk.
+	template<class F> void traverse(const Ray &ray, float &maxDist, F hitTriangle) const {
+		if (!nodes.empty()) walk(nodes.data(), order.data(), ray, maxDist, hitTriangle);
+	}
+
+	// traverse() over a tree stored elsewhere; with no order, leaves refer to items by their position in leaf order
+	template<class F> static void walk(const BVHNode *nodes, const int *order, const Ray &ray, float &maxDist, F hitTriangle) {
+		float entry;
+		if (!rayBoxEntry(ray, nodes[0].lo, nodes[0].hi, entry)) return;
+		pair<int, float> stack[64];		// node and where the ray enters it
+		int top = 0;
+		stack[top++] = make_pair(0, entry);
+		while (top > 0) {
+			pair<int, float> next = stack[--top];
+			if (next.second > maxDist) continue;
+			const BVHNode &node = nodes[next.first];
+			if (node.count > 0) {
+				for (int i = node.first; i < node.first + node.count; i++) hitTriangle(order ? order[i] : i);
+				continue;
+			}
+			float leftEntry, rightEntry;
+			bool leftHit = rayBoxEntry(ray, nodes[node.first].lo, nodes[node.first].hi, leftEntry);
+			bool rightHit = rayBoxEntry(ray, nodes[node.first + 1].lo, nodes[node.first + 1].hi, rightEntry);
+			if (leftHit && rightHit) {		// the nearer child goes on top, so it's walked first
+				if (leftEntry < rightEntry) {
+					stack[top++] = make_pair(node.first + 1, rightEntry);
+					stack[top++] = make_pair(node.first, leftEntry);
+				}
+				else {
+					stack[top++] = make_pair(node.first, leftEntry);
+					stack[top++] = make_pair(node.first + 1, rightEntry);
+				}
+			}
+			else if (leftHit) stack[top++] = make_pair(node.first, leftEntry);
+			else if (rightHit) stack[top++] = make_pair(node.first + 1, rightEntry);
+		}
+	}
+
+	int leafTriangles = 4;
+
+private:
+	void buildNode(int index, int first, int count, const vector<glm::vec3> &centers, const vector<glm::vec3> &triLo, const vector<glm::vec3> &triHi);
+
+	vector<BVHNode> nodes;
+	vector<int> order;		// triangle indices, grouped by leaf
+};
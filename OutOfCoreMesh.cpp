@@ -0,0 +1,542 @@
+#include "OutOfCoreMesh.h"
+#include "Tracer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Map length bytes of the file starting at offset. A writable mapping creates the file, or grows it, as needed.
+//
+MappedRegion::MappedRegion(const string &fileName, uint64_t offset, size_t length, bool writable) {
+	this->length = length;
+	if (length == 0) return;
+
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	uint64_t start = offset - offset % info.dwAllocationGranularity;
+	mappedLength = length + (offset - start);
+
+	file = CreateFileA(fileName.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = NULL;
+		return;
+	}
+	uint64_t end = offset + length;
+	mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, writable ? (DWORD)(end >> 32) : 0, writable ? (DWORD)end : 0, NULL);
+	if (!mapping) return;
+	base = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, mappedLength);
+	if (!base) return;
+#else
+	uint64_t pageSize = sysconf(_SC_PAGE_SIZE);
+	uint64_t start = offset - offset % pageSize;
+	mappedLength = length + (offset - start);
+
+	int fd = open(fileName.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (fd < 0) return;
+	struct stat st;
+	if (writable && fstat(fd, &st) == 0 && (uint64_t)st.st_size < offset + length && ftruncate(fd, offset + length) != 0) {
+		close(fd);
+		return;
+	}
+	void *p = mmap(NULL, mappedLength, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, start);
+	close(fd);		// the mapping keeps the file open
+	if (p == MAP_FAILED) return;
+	base = p;
+#endif
+	data = (char *)base + (offset - start);
+}
+
+MappedRegion::~MappedRegion() {
+#ifdef _WIN32
+	if (base) UnmapViewOfFile(base);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+#else
+	if (base) munmap(base, mappedLength);
+#endif
+}
+
+ChunkCache &ChunkCache::get() {
+	static ChunkCache cache;
+	return cache;
+}
+
+// Mapping happens outside the lock, so threads paging in different chunks don't wait on each other
+//
+shared_ptr<MappedRegion> ChunkCache::acquire(const OutOfCoreMesh *mesh, int chunk, const string &fileName, uint64_t offset, size_t length) {
+	pair<const OutOfCoreMesh *, int> key(mesh, chunk);
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto found = index.find(key);
+		if (found != index.end()) {
+			entries.splice(entries.begin(), entries, found->second);
+			return found->second->region;
+		}
+	}
+
+	shared_ptr<MappedRegion> region = make_shared<MappedRegion>(fileName, offset, length);
+	if (!region->isValid()) return NULL;
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	auto found = index.find(key);
+	if (found != index.end()) {		// another thread mapped it first; use theirs
+		entries.splice(entries.begin(), entries, found->second);
+		return found->second->region;
+	}
+	entries.push_front({ mesh, chunk, region });
+	index[key] = entries.begin();
+	resident += length;
+	loads++;
+	evictOverBudget();
+	return region;
+}
+
+//  Chunks a thread has pinned, replaced round robin
+//
+struct ThreadPins {
+	struct Pin {
+		const OutOfCoreMesh *mesh = NULL;
+		int chunk = -1;
+		shared_ptr<MappedRegion> region;
+	};
+	Pin pins[ChunkCache::pinCount];
+	int next = 0;
+};
+
+static ThreadPins &threadPins() {
+	thread_local ThreadPins pins;
+	return pins;
+}
+
+MappedRegion *ChunkCache::pin(const OutOfCoreMesh *mesh, int chunk, const string &fileName, uint64_t offset, size_t length) {
+	ThreadPins &pins = threadPins();
+	for (ThreadPins::Pin &p : pins.pins) {
+		if (p.mesh == mesh && p.chunk == chunk) return p.region.get();
+	}
+	shared_ptr<MappedRegion> region = acquire(mesh, chunk, fileName, offset, length);
+	if (!region) return NULL;
+	ThreadPins::Pin &p = pins.pins[pins.next];
+	pins.next = (pins.next + 1) % pinCount;
+	p.mesh = mesh;
+	p.chunk = chunk;
+	p.region = region;
+	return region.get();
+}
+
+void ChunkCache::unpinThread() {
+	for (ThreadPins::Pin &p : threadPins().pins) p = ThreadPins::Pin();
+}
+
+void ChunkCache::release(const OutOfCoreMesh *mesh) {
+	for (ThreadPins::Pin &p : threadPins().pins) {
+		if (p.mesh == mesh) p = ThreadPins::Pin();
+	}
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	for (auto e = entries.begin(); e != entries.end();) {
+		if (e->mesh != mesh) {
+			e++;
+			continue;
+		}
+		resident -= e->region->getSize();
+		index.erase(make_pair(e->mesh, e->chunk));
+		e = entries.erase(e);
+	}
+}
+
+void ChunkCache::setBudget(size_t bytes) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	budget = bytes;
+	evictOverBudget();
+}
+
+size_t ChunkCache::getResidentBytes(const OutOfCoreMesh *mesh) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	size_t bytes = 0;
+	for (Entry &e : entries) {
+		if (e.mesh == mesh) bytes += e.region->getSize();
+	}
+	return bytes;
+}
+
+void ChunkCache::getStats(uint64_t &loads, uint64_t &evictions) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	loads = this->loads;
+	evictions = this->evictions;
+}
+
+// Unmap the least recently used chunks until the rest fit in the budget; the newest one always stays.
+// Threads still reading an evicted chunk hold their own reference, so it's only unmapped once they finish.
+//
+void ChunkCache::evictOverBudget() {
+	while (resident > budget && entries.size() > 1) {
+		Entry &e = entries.back();
+		resident -= e.region->getSize();
+		index.erase(make_pair(e.mesh, e.chunk));
+		entries.pop_back();
+		evictions++;
+	}
+}
+
+OutOfCoreMesh::~OutOfCoreMesh() {
+	ChunkCache::get().release(this);
+	if (!chunkFileName.empty()) ofFile::removeFile(chunkFileName, false);
+}
+
+// Cell of the chunk grid a point falls in
+//
+static int cellOf(glm::vec3 p, glm::vec3 lo, glm::vec3 cellSize, const int dims[3]) {
+	int c[3];
+	for (int a = 0; a < 3; a++) c[a] = glm::clamp((int)((p[a] - lo[a]) / cellSize[a]), 0, dims[a] - 1);
+	return (c[2] * dims[1] + c[1]) * dims[0] + c[0];
+}
+
+// Split a chunk whose triangles sit in the triangle file at tris + chunk.offset into pieces of at most maxCount,
+// halving it at the median triangle center along its longest axis. The triangles are reordered in place in the
+// mapping, so a cell with a dense spot in it never has to fit in memory whole.
+//
+static void splitChunk(ChunkTri *tris, ChunkInfo chunk, uint32_t maxCount, vector<ChunkInfo> &out) {
+	if (chunk.count <= maxCount) {
+		out.push_back(chunk);
+		return;
+	}
+	ChunkTri *first = (ChunkTri *)((char *)tris + chunk.offset);
+	glm::vec3 size = chunk.hi - chunk.lo;
+	int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+	uint32_t half = chunk.count / 2;
+	std::nth_element(first, first + half, first + chunk.count, [axis](const ChunkTri &a, const ChunkTri &b) {
+		return a.v[0][axis] + a.v[1][axis] + a.v[2][axis] < b.v[0][axis] + b.v[1][axis] + b.v[2][axis];
+	});
+
+	ChunkInfo pieces[2];
+	pieces[0].offset = chunk.offset;
+	pieces[0].count = half;
+	pieces[1].offset = chunk.offset + (uint64_t)half * sizeof(ChunkTri);
+	pieces[1].count = chunk.count - half;
+	for (ChunkInfo &piece : pieces) {
+		piece.lo = glm::vec3(numeric_limits<float>::max());
+		piece.hi = glm::vec3(-numeric_limits<float>::max());
+		const ChunkTri *t = (const ChunkTri *)((char *)tris + piece.offset);
+		for (uint32_t i = 0; i < piece.count; i++) {
+			for (int k = 0; k < 3; k++) {
+				piece.lo = glm::min(piece.lo, t[i].v[k]);
+				piece.hi = glm::max(piece.hi, t[i].v[k]);
+			}
+		}
+		splitChunk(tris, piece, maxCount, out);
+	}
+}
+
+//  A triangle waiting in the scratch file to be written to its chunk
+//
+struct FaceRecord {
+	uint32_t cell;
+	uint32_t v[3];
+};
+
+// Four passes, none of which hold the whole mesh in memory: read the vertices into a scratch file and find the
+// bounds; read the faces, adding up vertex normals and noting each face's grid cell; write every face into its
+// cell's range of a scratch triangle file, splitting cells with more than chunkTriangles; then build each chunk's BVH and write the chunk to the chunk file with its
+// triangles in leaf order and the BVH after them. The scratch files are memory mapped and deleted at the end.
+//
+bool OutOfCoreMesh::build(string objFileName) {
+	TRACE_SCOPE("build out-of-core mesh", "load");
+	static std::atomic<int> nextId(0);
+
+	ChunkCache::get().release(this);
+	chunks.clear();
+	chunkTree.clear();
+	numTriangles = 0;
+	version++;
+	sourceFileName = ofToDataPath(objFileName, true);
+	if (chunkFileName.empty()) {
+		ofDirectory::createDirectory("meshcache", true, true);
+		chunkFileName = ofToDataPath("meshcache/" + ofFile(objFileName).getBaseName() + "_" + ofToString(nextId++) + ".chunks", true);
+	}
+	ofFile::removeFile(chunkFileName, false);
+	string vertFileName = chunkFileName + ".verts";
+	string normalFileName = chunkFileName + ".normals";
+	string faceFileName = chunkFileName + ".faces";
+	string triFileName = chunkFileName + ".tris";
+
+	FILE *obj = fopen(objFileName.c_str(), "r");
+	if (!obj) {
+		cout << "couldn't open " << objFileName << endl;
+		return false;
+	}
+
+	// pass 1: vertices
+	FILE *vertFile = fopen(vertFileName.c_str(), "wb");
+	if (!vertFile) {
+		fclose(obj);
+		cout << "couldn't write to " << vertFileName << endl;
+		return false;
+	}
+	char s[64];
+	uint64_t numVerts = 0;
+	glm::vec3 lo(numeric_limits<float>::max()), hi(-numeric_limits<float>::max());
+	while (fscanf(obj, "%63s", s) != EOF) {
+		if (strcmp(s, "v") != 0) continue;
+		glm::vec3 v;
+		if (fscanf(obj, "%f %f %f", &v.x, &v.y, &v.z) != 3) continue;
+		fwrite(&v, sizeof(v), 1, vertFile);
+		lo = glm::min(lo, v);
+		hi = glm::max(hi, v);
+		numVerts++;
+	}
+	fclose(vertFile);
+	if (numVerts == 0) {
+		fclose(obj);
+		ofFile::removeFile(vertFileName, false);
+		cout << "no vertices in " << objFileName << endl;
+		return false;
+	}
+
+	glm::vec3 center = (lo + hi) / 2;		// recentered like Mesh, so scaling and rotating happen about the middle
+	bottomCorner = lo - center;
+	topCorner = hi - center;
+
+	// a grid of roughly cube-shaped cells, about one per chunkTriangles faces (estimated from the vertex count)
+	glm::vec3 extent = glm::max(hi - lo, glm::vec3(glm::max(hi.x - lo.x, glm::max(hi.y - lo.y, hi.z - lo.z)) * 0.01f + 1e-6f));
+	float targetCells = glm::max(1.0f, numVerts * 2.0f / chunkTriangles);
+	float side = cbrt(extent.x * extent.y * extent.z / targetCells);
+	int dims[3];
+	glm::vec3 cellSize;
+	for (int a = 0; a < 3; a++) {
+		dims[a] = glm::clamp((int)round(extent[a] / side), 1, 64);
+		cellSize[a] = extent[a] / dims[a];
+	}
+	vector<uint32_t> cellCounts(dims[0] * dims[1] * dims[2], 0);
+
+	// pass 2: faces
+	bool ok;
+	{
+		MappedRegion vertRegion(vertFileName, 0, numVerts * sizeof(glm::vec3));
+		MappedRegion normalRegion(normalFileName, 0, numVerts * sizeof(glm::vec3), true);
+		FILE *faceFile = fopen(faceFileName.c_str(), "wb");
+		ok = vertRegion.isValid() && normalRegion.isValid() && faceFile;
+		if (ok) {
+			const glm::vec3 *verts = (const glm::vec3 *)vertRegion.getData();
+			glm::vec3 *normals = (glm::vec3 *)normalRegion.getData();
+			rewind(obj);
+			while (fscanf(obj, "%63s", s) != EOF) {
+				if (strcmp(s, "f") != 0) continue;
+				FaceRecord face;
+				bool valid = true;
+				for (int k = 0; k < 3; k++) {
+					if (fscanf(obj, "%63s", s) != 1) valid = false;
+					int i = atoi(s) - 1;		// atoi stops at the first '/' of "v/vt/vn"
+					if (i < 0 || i >= numVerts) valid = false;
+					face.v[k] = i;
+				}
+				if (!valid) continue;
+
+				glm::vec3 v0 = verts[face.v[0]], v1 = verts[face.v[1]], v2 = verts[face.v[2]];
+				glm::vec3 n = glm::cross(v1 - v0, v2 - v0);
+				if (glm::length(n) > 0) {
+					n = glm::normalize(n);
+					for (int k = 0; k < 3; k++) normals[face.v[k]] += n;
+				}
+				face.cell = cellOf((v0 + v1 + v2) / 3.0f, lo, cellSize, dims);
+				cellCounts[face.cell]++;
+				fwrite(&face, sizeof(face), 1, faceFile);
+				numTriangles++;
+			}
+		}
+		if (faceFile) fclose(faceFile);
+	}
+	fclose(obj);
+
+	// pass 3: lay the non-empty cells out one after another in the triangle file, then drop each face into place
+	uint64_t triBytes = 0;
+	if (ok && numTriangles > 0) {
+		vector<int> cellChunk(cellCounts.size(), -1);
+		uint64_t offset = 0;
+		for (int c = 0; c < cellCounts.size(); c++) {
+			if (cellCounts[c] == 0) continue;
+			ChunkInfo chunk;
+			chunk.lo = glm::vec3(numeric_limits<float>::max());
+			chunk.hi = glm::vec3(-numeric_limits<float>::max());
+			chunk.offset = offset;
+			chunk.count = cellCounts[c];
+			cellChunk[c] = chunks.size();
+			chunks.push_back(chunk);
+			offset += (uint64_t)chunk.count * sizeof(ChunkTri);
+		}
+		triBytes = offset;
+
+		MappedRegion vertRegion(vertFileName, 0, numVerts * sizeof(glm::vec3));
+		MappedRegion normalRegion(normalFileName, 0, numVerts * sizeof(glm::vec3));
+		MappedRegion chunkRegion(triFileName, 0, offset, true);
+		FILE *faceFile = fopen(faceFileName.c_str(), "rb");
+		ok = vertRegion.isValid() && normalRegion.isValid() && chunkRegion.isValid() && faceFile;
+		if (ok) {
+			const glm::vec3 *verts = (const glm::vec3 *)vertRegion.getData();
+			const glm::vec3 *normals = (const glm::vec3 *)normalRegion.getData();
+			vector<uint32_t> written(chunks.size(), 0);
+			FaceRecord face;
+			while (fread(&face, sizeof(face), 1, faceFile) == 1) {
+				int c = cellChunk[face.cell];
+				ChunkInfo &chunk = chunks[c];
+				ChunkTri *tri = (ChunkTri *)(chunkRegion.getData() + chunk.offset) + written[c]++;
+				for (int k = 0; k < 3; k++) {
+					tri->v[k] = verts[face.v[k]] - center;
+					glm::vec3 n = normals[face.v[k]];
+					tri->n[k] = (glm::length(n) > 0) ? glm::normalize(n) : glm::vec3(0, 1, 0);
+					chunk.lo = glm::min(chunk.lo, tri->v[k]);
+					chunk.hi = glm::max(chunk.hi, tri->v[k]);
+				}
+			}
+
+			// the grid is at most 64 cells a side, so a dense part of a big scan can put far more than chunkTriangles
+			// in one cell; split those so every chunk fits the cache budget the way the grid meant it to
+			vector<ChunkInfo> cells;
+			cells.swap(chunks);
+			for (const ChunkInfo &cell : cells) splitChunk((ChunkTri *)chunkRegion.getData(), cell, max(chunkTriangles, 1), chunks);
+		}
+		if (faceFile) fclose(faceFile);
+	}
+
+	// pass 4: one chunk at a time, sort the triangles into BVH leaves and write them out followed by the BVH
+	uint64_t chunkBytes = 0;
+	if (ok && numTriangles > 0) {
+		MappedRegion triRegion(triFileName, 0, triBytes);
+		FILE *chunkFile = fopen(chunkFileName.c_str(), "wb");
+		ok = triRegion.isValid() && chunkFile;
+		vector<glm::vec3> triLo, triHi;
+		vector<ChunkTri> sorted;
+		TriangleBVH bvh;
+		for (int c = 0; c < chunks.size() && ok; c++) {
+			ChunkInfo &chunk = chunks[c];
+			const ChunkTri *tris = (const ChunkTri *)(triRegion.getData() + chunk.offset);
+			triLo.resize(chunk.count);
+			triHi.resize(chunk.count);
+			for (uint32_t t = 0; t < chunk.count; t++) {
+				triLo[t] = glm::min(tris[t].v[0], glm::min(tris[t].v[1], tris[t].v[2]));
+				triHi[t] = glm::max(tris[t].v[0], glm::max(tris[t].v[1], tris[t].v[2]));
+			}
+			bvh.buildBoxes(triLo, triHi);
+			sorted.resize(chunk.count);
+			for (uint32_t t = 0; t < chunk.count; t++) sorted[t] = tris[bvh.getOrder()[t]];
+
+			chunk.offset = chunkBytes;
+			chunk.nodeCount = bvh.getNodes().size();
+			ok = fwrite(sorted.data(), sizeof(ChunkTri), sorted.size(), chunkFile) == sorted.size()
+				&& fwrite(bvh.getNodes().data(), sizeof(BVHNode), chunk.nodeCount, chunkFile) == chunk.nodeCount;
+			chunkBytes += chunk.getBytes();
+		}
+		if (chunkFile && fclose(chunkFile) != 0) ok = false;
+	}
+
+	ofFile::removeFile(vertFileName, false);
+	ofFile::removeFile(normalFileName, false);
+	ofFile::removeFile(faceFileName, false);
+	ofFile::removeFile(triFileName, false);
+	if (!ok || numTriangles == 0) {
+		chunks.clear();
+		cout << "couldn't build an out-of-core mesh from " << objFileName << endl;
+		return false;
+	}
+
+	vector<glm::vec3> chunkLo, chunkHi;
+	for (ChunkInfo &chunk : chunks) {
+		chunkLo.push_back(chunk.lo);
+		chunkHi.push_back(chunk.hi);
+	}
+	chunkTree.buildBoxes(chunkLo, chunkHi);
+
+	cout << "vertices: " << numVerts << endl;
+	cout << "triangles: " << numTriangles << " in " << chunks.size() << " chunks (" << dims[0] << "x" << dims[1] << "x" << dims[2] << " grid)" << endl;
+	cout << "on disk: " << chunkBytes / (1024 * 1024) << "MB in " << chunkFileName << endl;
+	return true;
+}
+
+glm::vec3 OutOfCoreMesh::rotate(glm::vec3 n) {
+	glm::vec3 rot = rotation;
+	n = glm::rotateX(n, glm::radians(rot.x));
+	n = glm::rotateY(n, glm::radians(rot.y));
+	n = glm::rotateZ(n, glm::radians(rot.z));
+	return n;
+}
+
+glm::vec3 OutOfCoreMesh::inverseRotate(glm::vec3 v) {
+	glm::vec3 rot = rotation;
+	v = glm::rotateZ(v, glm::radians(-rot.z));
+	v = glm::rotateY(v, glm::radians(-rot.y));
+	v = glm::rotateX(v, glm::radians(-rot.x));
+	return v;
+}
+
+// World-space box around the mesh: the local bounding box's corners, transformed
+//
+bool OutOfCoreMesh::getBounds(glm::vec3 &lo, glm::vec3 &hi) {
+	if (chunks.empty()) return false;
+	lo = hi = rotate(bottomCorner) * (float)scale + position;
+	for (int c = 1; c < 8; c++) {
+		glm::vec3 corner = glm::vec3((c & 1) ? topCorner.x : bottomCorner.x, (c & 2) ? topCorner.y : bottomCorner.y, (c & 4) ? topCorner.z : bottomCorner.z);
+		corner = rotate(corner) * (float)scale + position;
+		lo = glm::min(lo, corner);
+		hi = glm::max(hi, corner);
+	}
+	return true;
+}
+
+// The ray is moved into the mesh's local space, where it keeps the same distance parameter as in world space.
+// It walks the chunk BVH nearest chunks first, and each chunk's own BVH in the mapping; both walks skip anything that
+// starts beyond the closest hit so far.
+//
+bool OutOfCoreMesh::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
+	if (chunkTree.isEmpty()) return false;
+	Ray local = Ray(inverseRotate(ray.p - position) / (float)scale, inverseRotate(ray.d) / (float)scale);
+
+	ChunkCache &cache = ChunkCache::get();
+	float closest = numeric_limits<float>::max();
+	glm::vec3 closestNormal;
+	chunkTree.traverse(local, closest, [&](int c) {
+		const ChunkInfo &chunk = chunks[c];
+		MappedRegion *region = cache.pin(this, c, chunkFileName, chunk.offset, chunk.getBytes());
+		if (!region) return;
+
+		const ChunkTri *tris = (const ChunkTri *)region->getData();
+		const BVHNode *nodes = (const BVHNode *)(tris + chunk.count);
+		TriangleBVH::walk(nodes, NULL, local, closest, [&](int t) {
+			const ChunkTri &tri = tris[t];
+			glm::vec2 bary;
+			float dist;
+			if (glm::intersectRayTriangle(local.p, local.d, tri.v[0], tri.v[1], tri.v[2], bary, dist) && dist > 0 && dist < closest) {
+				closest = dist;
+				closestNormal = (1 - bary.x - bary.y) * tri.n[0] + bary.x * tri.n[1] + bary.y * tri.n[2];
+			}
+		});
+	});
+	if (closest == numeric_limits<float>::max()) return false;
+
+	point = ray.p + ray.d * closest;
+	normal = glm::normalize(rotate(closestNormal));
+	return true;
+}
+
+// Draw each chunk's bounding box; the triangles themselves are only ever touched by rays
+//
+void OutOfCoreMesh::draw() {
+	glm::vec3 rot = rotation;
+	ofPushMatrix();
+	ofTranslate(position);
+	ofRotateZDeg(rot.z);
+	ofRotateYDeg(rot.y);
+	ofRotateXDeg(rot.x);
+	ofScale(scale, scale, scale);
+	ofNoFill();
+	for (ChunkInfo &chunk : chunks) {
+		glm::vec3 size = chunk.hi - chunk.lo;
+		ofDrawBox((chunk.lo + chunk.hi) / 2, size.x, size.y, size.z);
+	}
+	ofFill();
+	ofPopMatrix();
+}
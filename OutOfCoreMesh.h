@@ -0,0 +1,147 @@
+#pragma once
+
+#include "SceneObject.h"
+#include "MeshBVH.h"
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+
+// Mesh that stays on disk instead of in memory, for scans too big to load as a Mesh.
+// On import the .obj is streamed through a few times: the vertices go to a scratch file, then each triangle is
+// sorted into a grid cell by its center and written to a chunk file together with its vertex positions and normals,
+// so every chunk can be used on its own; cells with more triangles than a chunk should hold are split at the median. Each chunk also gets a BVH over its triangles, stored in the file right after
+// them. Only the table of chunk bounding boxes and a BVH over those stay in memory. While rendering, a ray walks the
+// chunk BVH front to back and maps in just the chunks it reaches, then walks each chunk's own BVH straight out of the
+// mapping, so it tests about as few triangles as it would in an in-core Mesh. Mapped chunks are kept in a
+// least-recently-used cache shared by all out-of-core meshes, which unmaps the oldest chunks once its memory
+// budget is used up, so a mesh bigger than RAM renders more slowly rather than running out of memory. Each render
+// thread also pins the last few chunks it used, so going back to them doesn't take the cache's lock.
+
+//  A memory mapping of part of a file
+//
+class MappedRegion {
+public:
+	MappedRegion(const string &fileName, uint64_t offset, size_t length, bool writable = false);
+	~MappedRegion();
+
+	bool isValid() { return data != NULL; }
+	char *getData() { return data; }
+	size_t getSize() { return length; }
+
+private:
+	void *base = NULL;		// start of the mapping, rounded down to the system's mapping granularity
+	size_t mappedLength = 0;
+	char *data = NULL;		// the requested offset within the mapping
+	size_t length = 0;
+#ifdef _WIN32
+	void *file = NULL;
+	void *mapping = NULL;
+#endif
+};
+
+//  A triangle as it's stored in a chunk, in the mesh's local space
+//
+struct ChunkTri {
+	glm::vec3 v[3];
+	glm::vec3 n[3];		// vertex normals
+};
+
+//  Location and bounds of one chunk in the chunk file
+//
+struct ChunkInfo {
+	glm::vec3 lo, hi;
+	uint64_t offset;	// in bytes
+	uint32_t count;		// triangles, stored in the order of the chunk BVH's leaves
+	uint32_t nodeCount;	// chunk BVH nodes, stored right after the triangles
+
+	size_t getBytes() const { return (size_t)count * sizeof(ChunkTri) + (size_t)nodeCount * sizeof(BVHNode); }
+};
+
+class OutOfCoreMesh;
+
+//  Least-recently-used cache of mapped chunks, shared by every out-of-core mesh
+//
+class ChunkCache {
+public:
+	static ChunkCache &get();
+
+	// Map a chunk, or find it already mapped. The region stays valid while the caller holds it, even if it's evicted.
+	shared_ptr<MappedRegion> acquire(const OutOfCoreMesh *mesh, int chunk, const string &fileName, uint64_t offset, size_t length);
+	void release(const OutOfCoreMesh *mesh);	// drop every chunk of a mesh, and the calling thread's pins of them
+
+	// acquire(), except that the calling thread keeps the last pinCount chunks it asked for and finds them again without
+	// taking the lock. The region stays valid until the thread pins pinCount others or calls unpinThread(), which render
+	// threads do at the end of every pass so they don't keep evicted chunks mapped.
+	MappedRegion *pin(const OutOfCoreMesh *mesh, int chunk, const string &fileName, uint64_t offset, size_t length);
+	static void unpinThread();
+	static const int pinCount = 16;
+
+	void setBudget(size_t bytes);
+	size_t getResidentBytes(const OutOfCoreMesh *mesh);
+	void getStats(uint64_t &loads, uint64_t &evictions);
+
+private:
+	struct Entry {
+		const OutOfCoreMesh *mesh;
+		int chunk;
+		shared_ptr<MappedRegion> region;
+	};
+
+	void evictOverBudget();
+
+	std::mutex cacheMutex;
+	list<Entry> entries;		// most recently used first
+	map<pair<const OutOfCoreMesh *, int>, list<Entry>::iterator> index;
+	size_t budget = (size_t)512 << 20;
+	size_t resident = 0;
+	uint64_t loads = 0;
+	uint64_t evictions = 0;
+};
+
+//  Chunked, memory-mapped mesh
+//
+class OutOfCoreMesh : public SceneObject {
+public:
+	OutOfCoreMesh(glm::vec3 pos) {
+		position = pos;
+		settings.setup();
+		settings.add(scale.setup("Scale", 1.0, 0.01, 10.0));
+		settings.add(rotation.setup("Rotation", glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(360, 360, 360)));
+		settings.add(diffuseColor.setup("Diffuse Color", ofColor::grey, ofColor::black, ofColor::white));
+		settings.add(specularColor.setup("Specular Color", ofColor::white, ofColor::black, ofColor::white));
+	}
+	~OutOfCoreMesh();
+
+	// Convert an .obj file into a chunk file in bin/data/meshcache, which is deleted along with the mesh
+	bool build(string objFileName);
+	string getSourceFileName() { return sourceFileName; }		// absolute path of the .obj it was built from
+
+	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	bool getBounds(glm::vec3 &lo, glm::vec3 &hi);
+	void draw();		// chunk bounding boxes, since the triangles aren't in memory
+	size_t getMemoryUsage() { return chunks.capacity() * sizeof(ChunkInfo) + chunkTree.getMemoryUsage() + ChunkCache::get().getResidentBytes(this); }
+	uint64_t getSignature() {
+		uint64_t h = SceneObject::getSignature();
+		hashValue(h, (float)scale);
+		hashValue(h, (glm::vec3)rotation);
+		hashValue(h, numTriangles);
+		return h;
+	}
+
+	int chunkTriangles = 4096;		// triangles per chunk the grid is sized for; denser cells are split down to this
+
+	ofxFloatSlider scale;
+	ofxVec3Slider rotation;
+
+private:
+	glm::vec3 rotate(glm::vec3 n);			// same order as Mesh's transform
+	glm::vec3 inverseRotate(glm::vec3 v);
+
+	string chunkFileName;
+	string sourceFileName;
+	vector<ChunkInfo> chunks;
+	TriangleBVH chunkTree;					// over the chunk boxes
+	glm::vec3 bottomCorner, topCorner;		// local bounds of the whole mesh
+	uint64_t numTriangles = 0;
+};
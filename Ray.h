@@ -21,4 +21,21 @@ public:
 
 	glm::vec3 p, d, inv_d;
 	int sign[3];
-};
\ No newline at end of file
+};
+
+// Distance along the ray to where it enters the box, if it hits it at all (slab test)
+//
+inline bool rayBoxEntry(const Ray &r, glm::vec3 lo, glm::vec3 hi, float &entry) {
+	float tmin = 0;
+	float tmax = numeric_limits<float>::max();
+	for (int a = 0; a < 3; a++) {
+		float t0 = (lo[a] - r.p[a]) * r.inv_d[a];
+		float t1 = (hi[a] - r.p[a]) * r.inv_d[a];
+		if (t0 > t1) std::swap(t0, t1);
+		tmin = max(tmin, t0);
+		tmax = min(tmax, t1);
+		if (tmin > tmax) return false;
+	}
+	entry = tmin;
+	return true;
+}
\ No newline at end of file
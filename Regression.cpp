@@ -0,0 +1,328 @@
+#include "Regression.h"
+#include "ofApp.h"
+
+static const RenderPath paths[] = {
+	{ "general, 1 thread", false, false, false, true, false, false, false, false },
+	{ "general", false, false, false, false, false, false, false, false },
+	{ "kernels", false, true, false, false, false, false, false, false },
+	{ "wavefront", true, false, false, false, false, false, false, false },
+	{ "wavefront, sorted shadows", true, false, true, false, false, false, false, false },
+	{ "regions", false, false, false, false, true, false, false, false },
+	{ "preview", false, false, false, false, false, false, false, true },
+	{ "out-of-core", false, false, false, false, false, false, true, false },
+	{ "levels of detail", false, false, false, false, false, true, false, false },
+};
+
+ReferenceScene::~ReferenceScene() {
+	for (SceneObject *obj : objects) delete obj;
+	delete outOfCore;
+}
+
+// Checkerboard made here rather than loaded from a file, so the golden images don't depend on image assets
+//
+static ofImage checkerTexture(int size, int cells, ofColor a, ofColor b) {
+	ofPixels pixels;
+	pixels.allocate(size, size, OF_PIXELS_RGB);
+	int cell = size / cells;
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) pixels.setColor(x, y, ((x / cell + y / cell) % 2) ? a : b);
+	}
+	ofImage image;
+	image.setUseTexture(false);
+	image.setFromPixels(pixels);
+	return image;
+}
+
+// Write an octahedron as an .obj file, so the mesh scene goes through the same loader as a dropped file
+//
+static void writeOctahedron(string fileName) {
+	ofstream out(ofToDataPath(fileName));
+	out << "v 0 1.5 0\nv 1.5 0 0\nv 0 0 1.5\nv -1.5 0 0\nv 0 0 -1.5\nv 0 -1.5 0\n";
+	out << "f 1 3 2\nf 1 4 3\nf 1 5 4\nf 1 2 5\nf 6 2 3\nf 6 3 4\nf 6 4 5\nf 6 5 2\n";
+}
+
+// Write a UV sphere of radius r around the origin as an .obj file, fine enough that levels of detail are picked for
+// it at the regression resolution
+//
+static void writeSphere(string fileName, float r, int segments, int rings) {
+	ofstream out(ofToDataPath(fileName));
+	out << "v 0 " << r << " 0\n";
+	for (int j = 1; j < rings; j++) {
+		float theta = PI * j / rings;
+		for (int i = 0; i < segments; i++) {
+			float phi = TWO_PI * i / segments;
+			out << "v " << r * sin(theta) * cos(phi) << " " << r * cos(theta) << " " << r * sin(theta) * sin(phi) << "\n";
+		}
+	}
+	out << "v 0 " << -r << " 0\n";
+
+	// vertex 1 is the top pole, then one ring of segments vertices after another, then the bottom pole
+	auto ring = [segments](int j, int i) { return 2 + (j - 1) * segments + (i % segments); };
+	int bottom = 2 + (rings - 1) * segments;
+	for (int i = 0; i < segments; i++) {
+		out << "f 1 " << ring(1, i + 1) << " " << ring(1, i) << "\n";
+		for (int j = 1; j + 1 < rings; j++) {
+			out << "f " << ring(j, i) << " " << ring(j, i + 1) << " " << ring(j + 1, i + 1) << "\n";
+			out << "f " << ring(j, i) << " " << ring(j + 1, i + 1) << " " << ring(j + 1, i) << "\n";
+		}
+		out << "f " << bottom << " " << ring(rings - 1, i) << " " << ring(rings - 1, i + 1) << "\n";
+	}
+}
+
+// A mesh scene: a floor, the mesh in fileName at the origin, where the bounding box from loading is correct without a
+// draw(), and a light. The same file is also built as an out-of-core mesh, in small chunks so there are many of them.
+//
+static ReferenceScene *meshScene(string name, string fileName) {
+	ReferenceScene *scene = new ReferenceScene();
+	scene->name = name;
+	Plane *floor = new Plane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0), 20, 20);
+	floor->bInfinite = true;
+	scene->objects.push_back(floor);
+	Mesh *mesh = new Mesh(glm::vec3(0, 0, 0));
+	mesh->readObjFile(ofToDataPath(fileName));
+	scene->objects.push_back(mesh);
+	scene->outOfCore = new OutOfCoreMesh(glm::vec3(0, 0, 0));
+	scene->outOfCore->chunkTriangles = 64;
+	if (!scene->outOfCore->build(fileName)) {
+		delete scene->outOfCore;
+		scene->outOfCore = NULL;
+	}
+	scene->lights.push_back(new Light(glm::vec3(-6, 8, 10), 1.2));
+	return scene;
+}
+
+// The reference scenes, all in front of the render camera's default position: plain spheres with a point light,
+// spotlights, textured planes, and meshes
+//
+void RegressionHarness::buildScenes(vector<ReferenceScene *> &scenes) {
+	ReferenceScene *spheres = new ReferenceScene();
+	spheres->name = "spheres";
+	Plane *floor = new Plane(glm::vec3(0, -1, 0), glm::vec3(0, 1, 0), 20, 20);
+	floor->bInfinite = true;
+	spheres->objects.push_back(floor);
+	spheres->objects.push_back(new Sphere(glm::vec3(2.5, 0.5, -2), 1.5, ofColor::lime));
+	spheres->objects.push_back(new Sphere(glm::vec3(-2.5, 1, -4), 2, ofColor::magenta));
+	spheres->objects.push_back(new Sphere(glm::vec3(0, 2, -9), 1.5, ofColor::crimson));
+	spheres->lights.push_back(new Light(glm::vec3(8, 6, 10), 1.2));
+	scenes.push_back(spheres);
+
+	ReferenceScene *spots = new ReferenceScene();
+	spots->name = "spotlights";
+	floor = new Plane(glm::vec3(0, -1, 0), glm::vec3(0, 1, 0), 20, 20);
+	floor->bInfinite = true;
+	spots->objects.push_back(floor);
+	spots->objects.push_back(new Sphere(glm::vec3(-2, 0.5, -3), 1.5, ofColor::skyBlue));
+	spots->objects.push_back(new Sphere(glm::vec3(2.5, 0, -5), 1, ofColor::orange));
+	spots->lights.push_back(new Spotlight(glm::vec3(-6, 8, 4), 1.5, glm::vec3(4, -8, -7), 15));
+	spots->lights.push_back(new Spotlight(glm::vec3(6, 8, 0), 1.5, glm::vec3(-3.5, -8, -5), 10));
+	spots->lights.push_back(new Light(glm::vec3(0, 10, 12), 0.4));
+	scenes.push_back(spots);
+
+	ReferenceScene *textures = new ReferenceScene();
+	textures->name = "textures";
+	floor = new Plane(glm::vec3(0, -1, 0), glm::vec3(0, 1, 0), 20, 20);
+	floor->bInfinite = true;
+	floor->setTexture(checkerTexture(64, 8, ofColor::white, ofColor::darkSlateGray));
+	Plane *picture = new Plane(glm::vec3(-3, 2, -8), glm::vec3(0.3, 0, 1), 6, 4);
+	picture->setTexture(checkerTexture(64, 4, ofColor::gold, ofColor::navy));
+	textures->objects.push_back(floor);
+	textures->objects.push_back(picture);
+	textures->objects.push_back(new Sphere(glm::vec3(2.5, 0.5, -3), 1.5, ofColor::lightGray));
+	textures->lights.push_back(new Light(glm::vec3(6, 8, 10), 1.2));
+	scenes.push_back(textures);
+
+	writeOctahedron(goldenDir + "/octahedron.obj");
+	scenes.push_back(meshScene("mesh", goldenDir + "/octahedron.obj"));
+	writeSphere(goldenDir + "/sphere.obj", 1.5, 64, 32);
+	scenes.push_back(meshScene("dense_mesh", goldenDir + "/sphere.obj"));
+
+	for (ReferenceScene *s : scenes) {
+		for (Light *l : s->lights) s->objects.push_back(l);
+	}
+}
+
+// Render everything with fixed settings, then put the app's own scene and settings back
+//
+bool RegressionHarness::run(ofApp *app) {
+	TRACE_SCOPE("regression", "render");
+	ofDirectory::createDirectory(goldenDir, true, true);
+
+	// the golden images aren't part of the repository, so a fresh checkout has to record them before it can check
+	ofDirectory golden(goldenDir);
+	golden.allowExt("png");
+	if (!record && golden.listDir() == 0) {
+		cout << "regression: FAILED, there are no golden images in bin/data/" << goldenDir << " yet; run the app once with "
+			<< "--record-golden at a revision whose renders are known to be right, then check against them" << endl;
+		return false;
+	}
+
+	vector<ReferenceScene *> scenes;
+	buildScenes(scenes);
+
+	vector<SceneObject *> savedScene = app->scene;
+	vector<Light *> savedLights = app->lights;
+	int savedWidth = app->imageWidth;
+	int savedHeight = app->imageHeight;
+	int savedThreads = app->renderThreads;
+	float savedFalloff = app->lightFalloff, savedPower = app->phongPower, savedAmbient = app->ambientStrength, savedThreshold = app->aaThreshold;
+	int savedGrid = app->aaGrid;
+	float savedLodError = app->lodError;
+	bool savedImportance = app->lightImportance, savedWavefront = app->wavefront, savedKernels = app->specializedKernels, savedSort = app->sortShadowRays;
+
+	app->lightFalloff = 1.0f;
+	app->phongPower = 100.0f;
+	app->ambientStrength = 0.3f;
+	app->aaThreshold = 0.1f;
+	app->aaGrid = 3;
+	app->lodError = 0.0f;		// always full detail, so the goldens don't depend on the camera
+	app->lightImportance = false;
+	app->imageWidth = width;
+	app->imageHeight = height;
+	app->image.allocate(width, height, OF_IMAGE_COLOR);
+	app->printProgress = false;
+
+	int failures = 0, recorded = 0, renders = 0;
+	for (ReferenceScene *s : scenes) {
+		Mesh *mesh = NULL;
+		for (SceneObject *obj : s->objects) {
+			if (!mesh) mesh = dynamic_cast<Mesh *>(obj);
+		}
+		map<string, ofPixels> goldens;		// by file name, loaded or recorded by the first path that uses each
+
+		for (const RenderPath &path : paths) {
+			if ((path.lod || path.outOfCore) && !mesh) continue;
+			if (path.outOfCore && !s->outOfCore) {
+				cout << "regression " << s->name << " (" << path.name << "): FAILED, couldn't build the out-of-core mesh" << endl;
+				failures++;
+				continue;
+			}
+			app->scene = s->objects;
+			app->lights = s->lights;
+			if (path.outOfCore) std::replace(app->scene.begin(), app->scene.end(), (SceneObject *)mesh, (SceneObject *)s->outOfCore);
+			app->wavefront = path.wavefront;
+			app->specializedKernels = path.kernels;
+			app->sortShadowRays = path.sortShadowRays;
+			app->renderThreads = path.singleThread ? 1 : savedThreads;
+			app->lodError = path.lod ? 1.0f : 0.0f;		// the default, which picks coarser levels for the dense mesh
+			ofPixels result;
+			if (path.regions) {		// uneven pieces, so their seams fall inside tiles and across edges
+				int xs[] = { 0, width / 3, width }, ys[] = { 0, height / 2 + 7, height };
+				result.allocate(width, height, OF_PIXELS_RGB);
+				for (int b = 0; b < 2; b++) {
+					for (int a = 0; a < 2; a++) {
+						ofPixels piece;
+						app->renderRegion(width, height, xs[a], ys[b], xs[a + 1] - xs[a], ys[b + 1] - ys[b], piece, true, true);
+						piece.pasteInto(result, xs[a], ys[b]);
+					}
+				}
+			}
+			else if (path.preview) {
+				app->previewRender(3600, false);
+				result = app->image.getPixels();
+			}
+			else {
+				app->renderImage(true, true);
+				result = app->image.getPixels();
+			}
+			renders++;
+
+			string goldenFile = goldenDir + "/" + s->name + (path.lod ? "_lod" : "") + ".png";
+			if (!goldens.count(goldenFile)) {
+				if (record) {
+					ofSaveImage(result, goldenFile);
+					goldens[goldenFile] = result;
+					recorded++;
+					cout << "regression " << s->name << ": recorded " << goldenFile << " from the " << path.name << " path" << endl;
+					continue;
+				}
+				if (!ofFile::doesFileExist(goldenFile) || !ofLoadImage(goldens[goldenFile], goldenFile)) {
+					cout << "regression " << s->name << " (" << path.name << "): FAILED, no golden image " << goldenFile
+						<< " (record them with --record-golden at a revision known to render correctly)" << endl;
+					goldens.erase(goldenFile);
+					failures++;
+					continue;
+				}
+			}
+			ofPixels &golden = goldens[goldenFile];
+			if (!check(result, golden, s->name + " (" + path.name + ")")) {
+				string base = goldenDir + "/failures/" + s->name + "_" + ofJoinString(ofSplitString(path.name, ", "), "_");
+				ofDirectory::createDirectory(goldenDir + "/failures", true, true);
+				ofSaveImage(result, base + ".png");
+
+				ofPixels diff;
+				diff.allocate(width, height, OF_PIXELS_RGB);
+				for (int y = 0; y < height; y++) {
+					for (int x = 0; x < width; x++) {
+						ofColor a = result.getColor(x, y);
+						ofColor b = golden.getColor(x, y);
+						diff.setColor(x, y, ofColor(min(255, abs(a.r - b.r) * 8), min(255, abs(a.g - b.g) * 8), min(255, abs(a.b - b.b) * 8)));
+					}
+				}
+				ofSaveImage(diff, base + "_diff.png");
+				failures++;
+			}
+		}
+	}
+
+	for (ReferenceScene *s : scenes) delete s;
+	app->scene = savedScene;
+	app->lights = savedLights;
+	app->imageWidth = savedWidth;
+	app->imageHeight = savedHeight;
+	app->image.allocate(savedWidth, savedHeight, OF_IMAGE_COLOR);
+	app->renderThreads = savedThreads;
+	app->lightFalloff = savedFalloff;
+	app->phongPower = savedPower;
+	app->ambientStrength = savedAmbient;
+	app->aaThreshold = savedThreshold;
+	app->aaGrid = savedGrid;
+	app->lodError = savedLodError;
+	app->lightImportance = savedImportance;
+	app->wavefront = savedWavefront;
+	app->specializedKernels = savedKernels;
+	app->sortShadowRays = savedSort;
+	app->printProgress = true;
+
+	cout << "regression: " << renders << " renders, " << failures << " failed, " << recorded << " golden images recorded" << endl;
+	return failures == 0;
+}
+
+// Compare one render against its golden image and print the result
+//
+bool RegressionHarness::check(const ofPixels &result, const ofPixels &golden, const string &label) {
+	if (result.getWidth() != golden.getWidth() || result.getHeight() != golden.getHeight()) {
+		cout << "regression " << label << ": FAILED, golden image is " << golden.getWidth() << "x" << golden.getHeight() << endl;
+		return false;
+	}
+
+	// count the pixels over the tolerance, and keep each pixel's luminance difference for the blurred comparison
+	int different = 0;
+	vector<float> lumaDiff(width * height);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			ofColor a = result.getColor(x, y);
+			ofColor b = golden.getColor(x, y);
+			if (abs(a.r - b.r) > pixelTolerance || abs(a.g - b.g) > pixelTolerance || abs(a.b - b.b) > pixelTolerance) different++;
+			float lumaA = 0.299f * a.r + 0.587f * a.g + 0.114f * a.b;
+			float lumaB = 0.299f * b.r + 0.587f * b.g + 0.114f * b.b;
+			lumaDiff[y * width + x] = abs(lumaA - lumaB);
+		}
+	}
+
+	// a lone noisy pixel averages out over a 5x5 window, but a shifted edge or changed shading doesn't
+	float worst = 0;
+	for (int y = 2; y < height - 2; y++) {
+		for (int x = 2; x < width - 2; x++) {
+			float sum = 0;
+			for (int dy = -2; dy <= 2; dy++) {
+				for (int dx = -2; dx <= 2; dx++) sum += lumaDiff[(y + dy) * width + x + dx];
+			}
+			worst = max(worst, sum / 25);
+		}
+	}
+
+	bool passed = different <= maxDifferentFraction * width * height && worst <= perceptualTolerance;
+	cout << "regression " << label << ": " << (passed ? "ok" : "FAILED") << ", " << different << " pixels differ, worst local difference "
+		<< worst << " levels" << endl;
+	return passed;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Lights.h"
+#include "OutOfCoreMesh.h"
+
+// Golden-image regression check for the renderer.
+// A few fixed reference scenes are rendered through every render path and compared against golden images kept in
+// bin/data/golden, so optimizations that are supposed to leave the output alone can be checked for it. A render
+// fails if too many pixels differ from the golden by more than a few levels, or if a blurred luminance difference
+// shows a visible change anywhere, e.g. a shadow edge that moved. Failed renders are saved in golden/failures
+// along with an amplified difference image. A missing golden image is a failure. The golden images aren't in the
+// repository: they're only made by starting the app with --record-golden, which has to be done once on every checkout,
+// at a revision whose output is known to be right, before the check can pass.
+// Run the check with the g key, or without a window by starting the app with --regress.
+// Most paths have to match the scene's golden image. Rendering with levels of detail is allowed to change the image,
+// so that path has a golden image of its own, which catches changes in what the levels of detail look like.
+
+class ofApp;
+
+//  A scene built only for regression renders; it owns its objects
+//
+struct ReferenceScene {
+	string name;
+	vector<SceneObject *> objects;		// lights go in here too
+	vector<Light *> lights;
+	OutOfCoreMesh *outOfCore = NULL;	// the scene's mesh built as an out-of-core mesh, if it has one
+
+	~ReferenceScene();
+};
+
+//  One way of producing the same image
+//
+struct RenderPath {
+	string name;
+	bool wavefront;
+	bool kernels;
+	bool sortShadowRays;
+	bool singleThread;
+	bool regions;		// rendered as separate regions with renderRegion and put back together
+	bool lod;			// meshes at the level of detail the default LOD error picks, checked against a golden of its own
+	bool outOfCore;		// the scene's mesh swapped for the out-of-core one
+	bool preview;		// through previewRender, with a budget long enough to reach full quality
+};
+
+//  Renders every reference scene through every path and checks them against the goldens
+//
+class RegressionHarness {
+public:
+	bool run(ofApp *app);		// true if every render matched its golden
+
+	bool record = false;				// write the golden images from this run instead of requiring them
+	string goldenDir = "golden";
+	int width = 300;					// same 3:2 aspect as the render camera's view plane
+	int height = 200;
+	int pixelTolerance = 3;				// channel difference a pixel may have without counting as different
+	float maxDifferentFraction = 0.002;	// fraction of pixels allowed to differ, for anti-aliasing noise
+	float perceptualTolerance = 2;		// largest allowed 5x5 average luminance difference, in color levels
+
+private:
+	void buildScenes(vector<ReferenceScene *> &scenes);
+	bool check(const ofPixels &result, const ofPixels &golden, const string &label);
+};
@@ -0,0 +1,48 @@
+#include "RenderPool.h"
+#include "Tracer.h"
+
+RenderPool::~RenderPool() {
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (std::thread &t : threads) t.join();
+}
+
+// Start any threads still missing, hand job to the first numThreads, and wait for them all to finish it
+//
+void RenderPool::run(int numThreads, std::function<void(int)> job) {
+	numThreads = max(1, numThreads);
+	std::lock_guard<std::mutex> runLock(runMutex);
+	std::unique_lock<std::mutex> lock(poolMutex);
+	while (threads.size() < numThreads) threads.push_back(std::thread(&RenderPool::threadLoop, this, (int)threads.size()));
+	this->job = job;
+	active = numThreads;
+	running = numThreads;
+	generation++;
+	jobReady.notify_all();
+	jobDone.wait(lock, [this] { return running == 0; });
+	this->job = nullptr;
+}
+
+// Wait for runs this thread takes part in until the pool is destroyed
+//
+void RenderPool::threadLoop(int index) {
+	Tracer::setThreadName("render thread " + ofToString(index));
+	uint64_t done = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(poolMutex);
+			jobReady.wait(lock, [&] { return stopping || (generation != done && index < active); });
+			if (stopping) return;
+			done = generation;
+		}
+		job(index);		// run() doesn't touch job until every thread is through
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			running--;
+		}
+		jobDone.notify_all();
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Render threads that live as long as the app, so a pass over the image (or a viewport frame) doesn't pay for
+// starting and joining a thread per core, and per-thread state (trace buffers, caches) stays with the same threads.
+// Threads are started the first time a run asks for that many.
+
+//  The render threads and the job they're running
+//
+class RenderPool {
+public:
+	~RenderPool();
+
+	// Call job(threadIndex) on numThreads threads at once and return when every call has returned.
+	// Runs from different threads take turns; job must not start a run itself.
+	void run(int numThreads, std::function<void(int)> job);
+
+private:
+	void threadLoop(int index);
+
+	std::mutex runMutex;		// held for a whole run
+	std::mutex poolMutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobDone;
+	vector<std::thread> threads;
+	std::function<void(int)> job;
+	int active = 0;				// threads taking part in the current run
+	int running = 0;			// of those, the ones still in job
+	uint64_t generation = 0;	// counts runs, so a thread never runs the same one twice
+	bool stopping = false;
+};
@@ -0,0 +1,221 @@
+#include "RenderServer.h"
+#include "ofApp.h"
+#include <set>
+
+// The scene objects belong to the cached scenes, so the app mustn't be left pointing at them
+//
+RenderServer::~RenderServer() {
+	if (app) {
+		app->scene.clear();
+		app->lights.clear();
+	}
+	for (CachedScene &scene : scenes) deleteObjects(scene.objects);
+}
+
+// Serve one client at a time, on this machine only, until the process is stopped
+//
+bool RenderServer::run(ofApp *app, int port) {
+	this->app = app;
+	app->printProgress = false;
+	Socket server;
+	if (!server.listen(port, true)) {
+		cout << "render server: couldn't listen on port " << port << endl;
+		return false;
+	}
+	cout << "render server: listening on port " << port << " of this machine" << endl;
+	while (true) {
+		Socket *client = server.accept(1);
+		if (!client) continue;
+		client->setReceiveTimeout(clientTimeout);
+		serveClient(*client);
+		delete client;
+	}
+}
+
+// Take scenes and jobs from one client until it says it's done or goes away
+//
+void RenderServer::serveClient(Socket &client) {
+	uint32_t type;
+	vector<char> payload;
+	while (client.receiveMessage(type, payload, maxSceneMessage)) {
+		if (type == MSG_SCENE) addScene(payload);
+		else if (type == MSG_JOB) {
+			if (!renderJob(client, payload)) break;
+		}
+		else break;		// MSG_DONE, or something that isn't ours
+	}
+}
+
+// Read a packed scene and keep it, with everything built for it, under the hash of the packed bytes
+//
+void RenderServer::addScene(const vector<char> &packed) {
+	uint64_t key = 14695981039346656037ull;
+	hashBytes(key, packed.data(), packed.size());
+	for (CachedScene &scene : scenes) {
+		if (scene.key == key) return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	CachedScene scene;
+	scene.key = key;
+	ByteReader r(packed);
+	bool ok = readSettings(app, r);
+	scene.settings.assign(packed.begin(), packed.begin() + r.pos);
+	ok = ok && readScene(app, r, &assets);
+	scene.objects = app->scene;
+	scene.lights = app->lights;
+	app->scene.clear();
+	app->lights.clear();
+	if (!ok) {
+		cout << "render server: couldn't read a scene" << endl;
+		deleteObjects(scene.objects);
+		return;
+	}
+
+	scenesLoaded++;
+	cout << "render server: scene " << std::hex << key << std::dec << " of " << scene.objects.size() << " objects ready in "
+		<< std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() << "s" << endl;
+	scenes.push_front(std::move(scene));
+	while (scenes.size() > maxScenes) {
+		deleteObjects(scenes.back().objects);
+		scenes.pop_back();
+	}
+}
+
+// Each asset in byKey that lives in an object in gone is handed to another object with the same key that isn't gone,
+// or dropped if there's none
+//
+template<class T> static void replaceGone(map<uint64_t, T *> &byKey, const set<SceneObject *> &gone, const map<SceneObject *, uint64_t> &keys) {
+	for (auto it = byKey.begin(); it != byKey.end();) {
+		if (!gone.count(it->second)) {
+			it++;
+			continue;
+		}
+		T *standIn = NULL;
+		for (const auto &entry : keys) {
+			if (entry.second == it->first && !standIn) standIn = dynamic_cast<T *>(entry.first);
+		}
+		if (standIn) (it++)->second = standIn;
+		else it = byKey.erase(it);
+	}
+}
+
+// Delete a scene's objects. Meshes and textures of theirs that kept scenes have copies of stay available through one
+// of the copies, which share what was built for them.
+//
+void RenderServer::deleteObjects(const vector<SceneObject *> &objects) {
+	set<SceneObject *> gone(objects.begin(), objects.end());
+	for (SceneObject *obj : objects) assets.keys.erase(obj);
+	replaceGone(assets.meshes, gone, assets.keys);
+	replaceGone(assets.textures, gone, assets.keys);
+	for (SceneObject *obj : objects) delete obj;
+}
+
+// Answer a job from the result cache, or render it if the scene is here, or ask for the scene.
+// Returns false if the job couldn't be read or the client went away.
+//
+bool RenderServer::renderJob(Socket &client, const vector<char> &job) {
+	ByteReader r(job);
+	uint64_t sceneKey = r.get<uint64_t>();
+	int width = r.get<int>(), height = r.get<int>();
+	bool aa = r.get<bool>(), shadows = r.get<bool>();
+	if (!readCamera(app->renderCam, r) || width <= 0 || height <= 0 || width > 16384 || height > 16384) {
+		cout << "render server: bad job" << endl;
+		return false;
+	}
+
+	// the job's bytes cover the scene, frame and camera, so they're the result's key
+	uint64_t key = 14695981039346656037ull;
+	hashBytes(key, job.data(), job.size());
+	auto start = std::chrono::steady_clock::now();
+	bool cached = resultIndex.count(key);
+	if (cached) {
+		results.splice(results.begin(), results, resultIndex[key]);
+		resultHits++;
+	}
+	else {
+		auto scene = std::find_if(scenes.begin(), scenes.end(), [sceneKey](const CachedScene &s) { return s.key == sceneKey; });
+		if (scene == scenes.end()) return client.sendMessage(MSG_NEED_SCENE, vector<char>());
+		scenes.splice(scenes.begin(), scenes, scene);
+
+		ByteReader settings(scenes.front().settings);
+		readSettings(app, settings);
+		app->scene = scenes.front().objects;
+		app->lights = scenes.front().lights;
+		CachedResult result;
+		result.key = key;
+		app->renderRegion(width, height, 0, 0, width, height, result.pixels, aa, shadows);
+		result.pixels.setImageType(OF_IMAGE_COLOR);
+
+		resultBytes += result.pixels.getTotalBytes();
+		results.push_front(std::move(result));
+		resultIndex[key] = results.begin();
+		while (resultBytes > resultBudget && results.size() > 1) {		// never the one just rendered
+			resultBytes -= results.back().pixels.getTotalBytes();
+			resultIndex.erase(results.back().key);
+			results.pop_back();
+		}
+	}
+	jobs++;
+
+	ofPixels &pixels = results.front().pixels;
+	ByteWriter reply;
+	reply.put((int)pixels.getWidth());
+	reply.put((int)pixels.getHeight());
+	reply.put(cached);
+	reply.bytes.insert(reply.bytes.end(), (const char *)pixels.getData(), (const char *)pixels.getData() + pixels.getTotalBytes());
+	cout << "render server: " << width << "x" << height << (cached ? " from the result cache" : " rendered") << " in "
+		<< std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() << "s ("
+		<< resultHits << " of " << jobs << " jobs cached, " << scenesLoaded << " scenes loaded, "
+		<< assets.meshes.size() << " meshes and " << assets.textures.size() << " textures kept)" << endl;
+	return client.sendMessage(MSG_IMAGE, reply.bytes);
+}
+
+// Client side: send the job, send the scene only if the server asks for it, and wait for the image
+//
+bool requestRender(ofApp *app, const string &address, int width, int height, bool aa, ofPixels &result) {
+	string host;
+	int port;
+	Socket socket;
+	if (!splitAddress(address, host, port) || !socket.connect(host, port)) {
+		cout << "couldn't connect to a render server at " << address << endl;
+		return false;
+	}
+
+	ByteWriter scene;
+	writeSettings(app, scene);
+	writeScene(app, scene);
+	if (scene.bytes.size() > maxSceneMessage) {
+		cout << "scene is too big to send to a render server (" << scene.bytes.size() / (1024 * 1024) << "MB)" << endl;
+		return false;
+	}
+	uint64_t sceneKey = 14695981039346656037ull;
+	hashBytes(sceneKey, scene.bytes.data(), scene.bytes.size());
+
+	ByteWriter job;
+	job.put(sceneKey);
+	job.put(width);
+	job.put(height);
+	job.put(aa);
+	job.put(true);		// shadows
+	writeCamera(app->renderCam, job);
+
+	uint32_t type;
+	vector<char> payload;
+	uint64_t maxImage = 2 * sizeof(int) + sizeof(bool) + (uint64_t)width * height * 3;
+	bool ok = socket.sendMessage(MSG_JOB, job.bytes) && socket.receiveMessage(type, payload, maxImage);
+	if (ok && type == MSG_NEED_SCENE) {
+		ok = socket.sendMessage(MSG_SCENE, scene.bytes) && socket.sendMessage(MSG_JOB, job.bytes) && socket.receiveMessage(type, payload, maxImage);
+	}
+	ByteReader reply(payload);
+	int w = reply.get<int>(), h = reply.get<int>();
+	bool cached = reply.get<bool>();
+	if (!ok || type != MSG_IMAGE || !reply.ok || payload.size() - reply.pos != (size_t)w * h * 3) {
+		cout << "the render server at " << address << " didn't send back an image" << endl;
+		return false;
+	}
+	result.setFromPixels((const unsigned char *)payload.data() + reply.pos, w, h, OF_PIXELS_RGB);
+	socket.sendMessage(MSG_DONE, vector<char>());
+	cout << "image " << (cached ? "from the render server's result cache" : "rendered by the render server") << endl;
+	return true;
+}
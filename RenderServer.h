@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Distributed.h"
+#include "Lights.h"
+#include <list>
+
+// Long-running render server (the app started with --serve port), for rendering many views of the same scenes.
+// A client sends a job: the key of a scene, a frame size and a camera. The server keeps the last few scenes it was
+// sent with their meshes' normals, BVHs and levels of detail and their planes' texture mip chains already built, so a
+// job costs only the trace, and a job it has rendered before is answered from a cache of results. When the server
+// doesn't have the scene it answers MSG_NEED_SCENE, and the client sends it once.
+// A scene's key is the hash of its packed settings and objects, so any change to it makes a new scene; meshes and
+// textures the new scene shares with a kept one reuse what was built for that one.
+// Clients are served one at a time, in the order they connect. The server only listens on the loopback interface,
+// since a job can make it allocate a lot of memory and read any .obj file, and a client that sends nothing for
+// clientTimeout seconds is dropped so it can't hold up the ones behind it.
+
+class ofApp;
+
+//  The server side: a cache of scenes and one of results
+//
+class RenderServer {
+public:
+	~RenderServer();
+
+	// Serve jobs on port until the process is stopped; false if it couldn't listen
+	bool run(ofApp *app, int port);
+
+	int maxScenes = 4;								// scenes kept, least recently used dropped first
+	size_t resultBudget = (size_t)512 << 20;		// bytes of rendered images kept
+	float clientTimeout = 30;						// seconds a client may go without sending anything
+
+private:
+	struct CachedScene {
+		uint64_t key;
+		vector<char> settings;			// packed, applied before each job
+		vector<SceneObject *> objects;
+		vector<Light *> lights;
+	};
+	struct CachedResult {
+		uint64_t key;
+		ofPixels pixels;
+	};
+
+	void serveClient(Socket &client);
+	bool renderJob(Socket &client, const vector<char> &job);
+	void addScene(const vector<char> &packed);
+	void deleteObjects(const vector<SceneObject *> &objects);
+
+	ofApp *app = NULL;
+	list<CachedScene> scenes;			// most recently used first
+	list<CachedResult> results;			// most recently used first
+	map<uint64_t, list<CachedResult>::iterator> resultIndex;
+	size_t resultBytes = 0;
+	SceneAssets assets;					// meshes and textures of the kept scenes
+
+	uint64_t jobs = 0, resultHits = 0, scenesLoaded = 0;
+};
+
+// The client side: render the app's scene from its render camera on the server at host:port into result,
+// sending the scene only if the server doesn't have it already
+bool requestRender(ofApp *app, const string &address, int width, int height, bool aa, ofPixels &result);
@@ -4,23 +4,72 @@
 #include "glm/gtx/intersect.hpp"
 #include "Ray.h"
 
+class SceneObject;
+
 // Parent class of spheres, planes, spotlights, point lights, and meshes.
 // Must be able to draw itself to the OF view window, and check for intersection with a ray.
 // Have a modifiable diffuse color and specular color.
 
+// Mix the bytes of a value into a running FNV-1a hash
+//
+template<class T> void hashValue(uint64_t &h, const T &v) {
+	const unsigned char *bytes = (const unsigned char *)&v;
+	for (size_t i = 0; i < sizeof(T); i++) {
+		h ^= bytes[i];
+		h *= 1099511628211ull;
+	}
+}
+
+// Mix a run of bytes, such as a vector's contents, into a running FNV-1a hash
+//
+inline void hashBytes(uint64_t &h, const void *data, size_t length) {
+	const unsigned char *bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < length; i++) {
+		h ^= bytes[i];
+		h *= 1099511628211ull;
+	}
+}
+
+//  The closest intersection found along a ray
+//
+struct HitRecord {
+	SceneObject *obj;
+	glm::vec3 point, normal;
+	float dist;
+};
+
 //  Base class for any renderable object in the scene
 //
 class SceneObject {
 public:
+	virtual ~SceneObject() {}
 	virtual void draw() = 0;    // pure virtual funcs - must be overloaded
 	virtual bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) { cout << "SceneObject::intersect" << endl; return false; }
-	virtual ofColor getColorAt(glm::vec3 point) { return diffuseColor; }
+	virtual ofColor getColorAt(glm::vec3 point, float footprint = 0) { return diffuseColor; }	// footprint: world-space width of one image pixel at point
+
+	// world-space box around the object, for skipping it quickly; false if it has no finite bounds
+	virtual bool getBounds(glm::vec3 &lo, glm::vec3 &hi) { return false; }
+
+	// bytes of heap memory the object's geometry and textures take up (not counting its settings panel)
+	virtual size_t getMemoryUsage() { return 0; }
+
+	// hash of every setting that changes how the object renders, to tell when cached render results are stale
+	virtual uint64_t getSignature() {
+		uint64_t h = 14695981039346656037ull;
+		hashValue(h, position);
+		hashValue(h, (ofColor)diffuseColor);
+		hashValue(h, (ofColor)specularColor);
+		hashValue(h, isVisible);
+		hashValue(h, version);
+		return h;
+	}
 
 	// any data common to all scene objects goes here
 	glm::vec3 position = glm::vec3(0, 0, 0);
 
 	bool isSelectable = true;
 	bool isVisible = true;
+	uint64_t version = 0;		// bumped on every change the settings don't show, like new geometry or a new texture
 
 	ofxPanel settings;
 
@@ -1,33 +1,25 @@
 #include "Shapes.h"
 
-// Positive-only modulo, because the default fmod() can return negative results
+// Return the color at the given point (in world space); either a flat diffuse color or part of a texture
 //
-float pos_mod(float n, float d) {
-	float result = fmod(n, d);
-	return result < 0.0 ? result + d : result;
-}
-
-// Return the color at the given point (in world space); either a flat diffuse color or part of a texture
-//
-ofColor Plane::getColorAt(glm::vec3 point) {
-	if (!hasTexture) return diffuseColor;
-	glm::vec3 relOrigin = position;		// relative origin, in other words, where the texture starts from
-	if (!bInfinite) {
-		relOrigin = relOrigin + (basis1 * (height / 2)) - (basis2 * (width / 2));	// if it's a finite plane, start drawing from the corner
-	}
-	return texture.getColor(
-		pos_mod(floor(glm::dot((point - relOrigin), (basis2 * 80))), texture.getWidth()),
-		texture.getHeight() - 1 - pos_mod(floor(glm::dot((point - relOrigin), (basis1 * 80))), texture.getHeight())
-	);
-	// ^ This looks like a complete mess but it's actually not too bad: 
-	//		basis*80 turns the basis from being 1 OF unit long, which is kind of big, into being 80 times smaller
-	//		point - relOrigin is the vector to the intersect point from the relative origin
-	//		glm::dot() is how you get subspace coordinates given a basis vector and a vector on the subspace (i.e. the location of the pixels on the image source file)
-	//		floor() so we don't accidentally get any overflow
-	//		pos_mod() so that the image repeats in a tile pattern
-	//		texture.getheight() - 1 so the image isn't upside down
-}
-
+ofColor Plane::getColorAt(glm::vec3 point, float footprint) {
+	if (!hasTexture) return diffuseColor;
+	glm::vec3 relOrigin = position;		// relative origin, in other words, where the texture starts from
+	if (!bInfinite) {
+		relOrigin = relOrigin + (basis1 * (height / 2)) - (basis2 * (width / 2));	// if it's a finite plane, start drawing from the corner
+	}
+	glm::vec3 rel = point - relOrigin;
+	return mipTexture->sample(
+		glm::dot(rel, basis2) * texelScale,
+		texture.getHeight() - glm::dot(rel, basis1) * texelScale,
+		footprint * texelScale
+	);
+	// glm::dot() with a basis vector gives the subspace coordinates of the point on the plane, in OF units;
+	// texelScale turns that into texture pixels (the basis is 1 OF unit long, which is kind of big).
+	// The y coordinate is flipped so the image isn't upside down. The mip texture wraps the coordinates itself
+	// so the image repeats in a tile pattern, and uses the pixel footprint to pick a blurrier level far away.
+}
+
 // Intersect Ray with Plane  (wrapper on glm::intersectRayPlane)
 //
 bool Plane::intersect(const Ray &ray, glm::vec3 & point, glm::vec3 & normalAtIntersect) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "SceneObject.h"
+#include "Texture.h"
 
 // Simple geopmetric spheres and planes for ray tracing.
 // Planes may be infinte or finite, and can have texture applied to their surface.
@@ -24,6 +25,16 @@ public:
 	void draw() {
 		ofDrawSphere(position, radius);
 	}
+	bool getBounds(glm::vec3 &lo, glm::vec3 &hi) {
+		lo = position - glm::vec3(radius);
+		hi = position + glm::vec3(radius);
+		return true;
+	}
+	uint64_t getSignature() {
+		uint64_t h = SceneObject::getSignature();
+		hashValue(h, (float)radius);
+		return h;
+	}
 
 	ofxFloatSlider radius;
 };
@@ -63,11 +74,23 @@ public:
 	}
 	void setTexture(ofImage image) {
 		texture = image;
+		shared_ptr<MipTexture> mip = make_shared<MipTexture>();
+		mip->build(image);
+		mipTexture = mip;
 		hasTexture = true;
+		version++;
+	}
+	void setTexture(ofImage image, shared_ptr<MipTexture> mip) {		// mip already built from image
+		texture = image;
+		mipTexture = mip;
+		hasTexture = true;
+		version++;
 	}
 	ofImage getTexture() {
 		return texture;
 	}
+	shared_ptr<MipTexture> getMipTexture() { return mipTexture; }
+	bool isTextured() { return hasTexture; }
 	void setNormal(glm::vec3 norm) {
 		normal = glm::normalize(norm);
 
@@ -89,7 +112,24 @@ public:
 		return normal;
 	}
 
-	ofColor getColorAt(glm::vec3);
+	ofColor getColorAt(glm::vec3 point, float footprint = 0);
+	bool getBounds(glm::vec3 &lo, glm::vec3 &hi) {
+		if (bInfinite) return false;
+		glm::vec3 extent = glm::abs(basis1) * (float)height / 2 + glm::abs(basis2) * (float)width / 2;		// same axes as intersect()
+		lo = position - extent;
+		hi = position + extent;
+		return true;
+	}
+	size_t getMemoryUsage() { return texture.getPixels().getTotalBytes() + (mipTexture ? mipTexture->getMemoryUsage() : 0); }
+	uint64_t getSignature() {
+		uint64_t h = SceneObject::getSignature();
+		hashValue(h, normal);
+		hashValue(h, (float)width);
+		hashValue(h, (float)height);
+		hashValue(h, bInfinite);
+		hashValue(h, hasTexture);
+		return h;
+	}
 
 	ofPlanePrimitive plane;
 	ofxFloatSlider width;
@@ -99,6 +139,8 @@ public:
 private:
 	bool hasTexture = false;	// no texture by default
 	ofImage texture;
+	shared_ptr<MipTexture> mipTexture;		// tiled mip chain built from texture, used for sampling; shared by planes with the same texture
+	float texelScale = 80;		// texture pixels per OF unit
 
 	glm::vec3 normal = glm::vec3(0, 1, 0);
 	glm::vec3 basis1 = glm::vec3(1, 0, 0);
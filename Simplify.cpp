@@ -0,0 +1,238 @@
+#include "Simplify.h"
+#include <array>
+#include <queue>
+
+//  Symmetric 4x4 error quadric, stored as its 10 unique entries
+//
+struct Quadric {
+	double a[10] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	double area = 0;		// of the faces summed in, to turn the error back into a distance
+
+	// squared distance to the plane dot(n, p) + d = 0, times weight
+	void addPlane(glm::vec3 n, double d, double weight) {
+		double x = n.x, y = n.y, z = n.z;
+		a[0] += weight * x * x; a[1] += weight * x * y; a[2] += weight * x * z; a[3] += weight * x * d;
+		a[4] += weight * y * y; a[5] += weight * y * z; a[6] += weight * y * d;
+		a[7] += weight * z * z; a[8] += weight * z * d;
+		a[9] += weight * d * d;
+	}
+	Quadric &operator+=(const Quadric &q) {
+		for (int i = 0; i < 10; i++) a[i] += q.a[i];
+		area += q.area;
+		return *this;
+	}
+	double error(glm::vec3 p) const {
+		double x = p.x, y = p.y, z = p.z;
+		return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+			+ a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+			+ a[7] * z * z + 2 * a[8] * z + a[9];
+	}
+
+	// the point with the least error, unless the quadric is too flat to have a single one
+	bool optimum(glm::vec3 &p) const {
+		double det = a[0] * (a[4] * a[7] - a[5] * a[5]) - a[1] * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * a[5] - a[4] * a[2]);
+		if (abs(det) < 1e-12) return false;
+		double bx = -a[3], by = -a[6], bz = -a[8];
+		p.x = (bx * (a[4] * a[7] - a[5] * a[5]) - a[1] * (by * a[7] - a[5] * bz) + a[2] * (by * a[5] - a[4] * bz)) / det;
+		p.y = (a[0] * (by * a[7] - bz * a[5]) - bx * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * bz - by * a[2])) / det;
+		p.z = (a[0] * (a[4] * bz - a[5] * by) - a[1] * (a[1] * bz - by * a[2]) + bx * (a[1] * a[5] - a[4] * a[2])) / det;
+		return true;
+	}
+};
+
+//  A candidate edge collapse; stale once either vertex has changed since it was queued
+//
+struct Collapse {
+	double cost;			// area-weighted squared distance, which ranks the collapses
+	double distance;		// root mean square distance of the new vertex from the planes it stands for
+	int v0, v1;
+	int version0, version1;
+	glm::vec3 target;
+
+	bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+//  Working state of one simplification
+//
+struct Simplifier {
+	vector<glm::vec3> pos;
+	vector<Quadric> quadrics;
+	vector<int> version;
+	vector<bool> vertAlive;
+	vector<vector<int>> vertFaces;
+	vector<array<int, 3>> faces;
+	vector<bool> faceAlive;
+	glm::vec3 lo, hi;
+	std::priority_queue<Collapse, vector<Collapse>, std::greater<Collapse>> queue;
+
+	// Where to put the merged vertex and what it costs: the quadric's optimum if it has one inside the bounds,
+	// otherwise the best of the two ends and the midpoint
+	void push(int v0, int v1) {
+		Quadric q = quadrics[v0];
+		q += quadrics[v1];
+		glm::vec3 target;
+		if (!q.optimum(target) || glm::any(glm::lessThan(target, lo)) || glm::any(glm::greaterThan(target, hi))) {
+			glm::vec3 options[3] = { pos[v0], pos[v1], (pos[v0] + pos[v1]) / 2 };
+			target = options[0];
+			for (glm::vec3 &o : options) {
+				if (q.error(o) < q.error(target)) target = o;
+			}
+		}
+		double cost = max(0.0, q.error(target));
+		queue.push({ cost, sqrt(cost / max(q.area, 1e-12)), v0, v1, version[v0], version[v1], target });
+	}
+
+	// Would moving v to target turn any of its faces (other than the ones shared with other) over?
+	bool flips(int v, int other, glm::vec3 target) {
+		for (int f : vertFaces[v]) {
+			if (!faceAlive[f]) continue;
+			array<int, 3> &face = faces[f];
+			if (face[0] == other || face[1] == other || face[2] == other) continue;
+			glm::vec3 p[3], moved[3];
+			for (int k = 0; k < 3; k++) {
+				p[k] = pos[face[k]];
+				moved[k] = (face[k] == v) ? target : p[k];
+			}
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::length(after) == 0 || glm::dot(glm::normalize(before), glm::normalize(after)) < 0.2) return true;
+		}
+		return false;
+	}
+};
+
+float simplifyMesh(const vector<glm::vec3> &verts, const vector<Tri> &tris, int targetTris, vector<glm::vec3> &outVerts, vector<Tri> &outTris) {
+	Simplifier s;
+	int n = verts.size();
+	s.pos = verts;
+	s.quadrics.resize(n);
+	s.version.assign(n, 0);
+	s.vertAlive.assign(n, true);
+	s.vertFaces.resize(n);
+	s.lo = s.hi = verts.empty() ? glm::vec3(0, 0, 0) : verts[0];
+	for (const glm::vec3 &v : verts) {
+		s.lo = glm::min(s.lo, v);
+		s.hi = glm::max(s.hi, v);
+	}
+
+	// face planes, weighted by area, and the edges with how many faces use each
+	unordered_map<uint64_t, int> edgeUse;
+	int liveFaces = 0;
+	for (const Tri &t : tris) {
+		int f = s.faces.size();
+		s.faces.push_back({ t.vInd[0], t.vInd[1], t.vInd[2] });
+		bool degenerate = t.vInd[0] == t.vInd[1] || t.vInd[1] == t.vInd[2] || t.vInd[0] == t.vInd[2];
+		s.faceAlive.push_back(!degenerate);
+		if (degenerate) continue;
+		liveFaces++;
+
+		glm::vec3 cross = glm::cross(verts[t.vInd[1]] - verts[t.vInd[0]], verts[t.vInd[2]] - verts[t.vInd[0]]);
+		float area = glm::length(cross) / 2;
+		for (int k = 0; k < 3; k++) {
+			s.vertFaces[t.vInd[k]].push_back(f);
+			if (area > 0) {
+				s.quadrics[t.vInd[k]].addPlane(cross / (2 * area), -glm::dot(cross / (2 * area), verts[t.vInd[0]]), area);
+				s.quadrics[t.vInd[k]].area += area;
+			}
+			int a = min(t.vInd[k], t.vInd[(k + 1) % 3]);
+			int b = max(t.vInd[k], t.vInd[(k + 1) % 3]);
+			edgeUse[((uint64_t)a << 32) | b]++;
+		}
+	}
+
+	// edges on an open border get a steep plane at right angles to their face, so the border stays put
+	for (const Tri &t : tris) {
+		glm::vec3 cross = glm::cross(verts[t.vInd[1]] - verts[t.vInd[0]], verts[t.vInd[2]] - verts[t.vInd[0]]);
+		if (glm::length(cross) == 0) continue;
+		for (int k = 0; k < 3; k++) {
+			int a = min(t.vInd[k], t.vInd[(k + 1) % 3]);
+			int b = max(t.vInd[k], t.vInd[(k + 1) % 3]);
+			if (edgeUse[((uint64_t)a << 32) | b] != 1) continue;
+			glm::vec3 edge = verts[b] - verts[a];
+			glm::vec3 borderNormal = glm::cross(edge, cross);
+			if (glm::length(borderNormal) == 0) continue;
+			borderNormal = glm::normalize(borderNormal);
+			double weight = 1000 * glm::dot(edge, edge);
+			Quadric border;
+			border.addPlane(borderNormal, -glm::dot(borderNormal, verts[a]), weight);
+			s.quadrics[a] += border;
+			s.quadrics[b] += border;
+		}
+	}
+
+	for (auto &e : edgeUse) s.push(e.first >> 32, e.first & 0xffffffff);
+
+	double worst = 0;
+	while (liveFaces > targetTris && !s.queue.empty()) {
+		Collapse c = s.queue.top();
+		s.queue.pop();
+		if (!s.vertAlive[c.v0] || !s.vertAlive[c.v1] || s.version[c.v0] != c.version0 || s.version[c.v1] != c.version1) continue;
+		if (s.flips(c.v0, c.v1, c.target) || s.flips(c.v1, c.v0, c.target)) continue;
+
+		// merge v1 into v0; faces that had both are gone, the rest now use v0
+		s.pos[c.v0] = c.target;
+		s.quadrics[c.v0] += s.quadrics[c.v1];
+		s.vertAlive[c.v1] = false;
+		for (int f : s.vertFaces[c.v1]) {
+			if (!s.faceAlive[f]) continue;
+			array<int, 3> &face = s.faces[f];
+			if (face[0] == c.v0 || face[1] == c.v0 || face[2] == c.v0) {
+				s.faceAlive[f] = false;
+				liveFaces--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				if (face[k] == c.v1) face[k] = c.v0;
+			}
+			s.vertFaces[c.v0].push_back(f);
+		}
+		s.vertFaces[c.v1].clear();
+		vector<int> &v0Faces = s.vertFaces[c.v0];
+		v0Faces.erase(std::remove_if(v0Faces.begin(), v0Faces.end(), [&s](int f) { return !s.faceAlive[f]; }), v0Faces.end());
+		s.version[c.v0]++;
+		worst = max(worst, c.distance);
+
+		// requeue the edges around the merged vertex with its new quadric
+		vector<int> neighbors;
+		for (int f : v0Faces) {
+			for (int v : s.faces[f]) {
+				if (v != c.v0) neighbors.push_back(v);
+			}
+		}
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		for (int v : neighbors) s.push(c.v0, v);
+	}
+
+	// keep only the vertices still in use, renumbered
+	vector<int> remap(n, -1);
+	outVerts.clear();
+	outTris.clear();
+	for (int f = 0; f < s.faces.size(); f++) {
+		if (!s.faceAlive[f]) continue;
+		int index[3];
+		for (int k = 0; k < 3; k++) {
+			int v = s.faces[f][k];
+			if (remap[v] < 0) {
+				remap[v] = outVerts.size();
+				outVerts.push_back(s.pos[v]);
+			}
+			index[k] = remap[v];
+		}
+		outTris.push_back(Tri(index[0], index[1], index[2]));
+	}
+	return worst;
+}
+
+void computeNormals(const vector<glm::vec3> &verts, vector<Tri> &tris, vector<glm::vec3> &vertNormals) {
+	// one pass over the triangles adds each face normal to its three vertices; degenerate faces add nothing
+	vertNormals.assign(verts.size(), glm::vec3(0, 0, 0));
+	for (Tri &t : tris) {
+		glm::vec3 cross = glm::cross(verts[t.vInd[1]] - verts[t.vInd[0]], verts[t.vInd[2]] - verts[t.vInd[0]]);
+		t.normal = (glm::length(cross) > 0) ? glm::normalize(cross) : glm::vec3(0, 0, 0);
+		for (int k = 0; k < 3; k++) vertNormals[t.vInd[k]] += t.normal;
+	}
+	for (glm::vec3 &n : vertNormals) {
+		if (glm::length(n) > 0) n = glm::normalize(n);
+	}
+}
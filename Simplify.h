@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Mesh.h"
+
+// Mesh simplification by quadric error metrics (Garland and Heckbert, "Surface Simplification Using Quadric Error
+// Metrics", SIGGRAPH 1997). Every vertex keeps the sum of the squared-distance quadrics of the planes of its faces.
+// Edges are collapsed cheapest first, each into the point that minimizes the combined quadric, until the target
+// triangle count is reached. Open borders get extra perpendicular planes so they don't shrink, and collapses that
+// would flip a face over are skipped.
+
+// Simplify verts/tris down to about targetTris triangles, writing the result to outVerts/outTris (with face normals).
+// Returns the largest error of any collapse, as the root mean square distance in the mesh's units of the merged vertex
+// from the original faces it replaced.
+float simplifyMesh(const vector<glm::vec3> &verts, const vector<Tri> &tris, int targetTris, vector<glm::vec3> &outVerts, vector<Tri> &outTris);
+
+// Face normals of tris, and vertex normals averaged from them
+void computeNormals(const vector<glm::vec3> &verts, vector<Tri> &tris, vector<glm::vec3> &vertNormals);
@@ -0,0 +1,160 @@
+#include "Texture.h"
+
+// Spread the low 16 bits of n out to the even bits, so two of them can be interleaved into a Morton code
+//
+static uint32_t part1By1(uint32_t n) {
+	n &= 0x0000ffff;
+	n = (n ^ (n << 8)) & 0x00ff00ff;
+	n = (n ^ (n << 4)) & 0x0f0f0f0f;
+	n = (n ^ (n << 2)) & 0x33333333;
+	n = (n ^ (n << 1)) & 0x55555555;
+	return n;
+}
+
+static int nextPowerOfTwo(int n) {
+	int p = 1;
+	while (p < n) p <<= 1;
+	return p;
+}
+
+static int log2Int(int n) {
+	int l = 0;
+	while ((2 << l) <= n) l++;
+	return l;
+}
+
+// A non-square level is stored as a row of square Morton blocks; only one of x or y can reach past the first block.
+//
+Texel &MipTexture::Level::at(int x, int y) {
+	int mask = (1 << logBlock) - 1;
+	int block = (x >> logBlock) + (y >> logBlock);
+	return texels[(block << (2 * logBlock)) + (part1By1(x & mask) | (part1By1(y & mask) << 1))];
+}
+
+// Resample the image to power-of-two dimensions, then halve it repeatedly with a 2x2 box filter down to 1x1
+//
+void MipTexture::build(const ofImage &image) {
+	levels.clear();
+	const ofPixels &pixels = image.getPixels();
+	int srcW = pixels.getWidth();
+	int srcH = pixels.getHeight();
+	if (srcW == 0 || srcH == 0) return;
+
+	int w = nextPowerOfTwo(srcW);
+	int h = nextPowerOfTwo(srcH);
+	scaleX = w / (float)srcW;
+	scaleY = h / (float)srcH;
+
+	// level 0: bilinear resample of the source onto the power-of-two grid, wrapping at the edges since textures tile
+	vector<glm::vec3> current(w * h);
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			float sx = (x + 0.5f) / scaleX - 0.5f;
+			float sy = (y + 0.5f) / scaleY - 0.5f;
+			int x0 = floor(sx);
+			int y0 = floor(sy);
+			float fx = sx - x0;
+			float fy = sy - y0;
+			glm::vec3 c(0, 0, 0);
+			for (int dy = 0; dy < 2; dy++) {
+				for (int dx = 0; dx < 2; dx++) {
+					ofColor p = pixels.getColor(((x0 + dx) % srcW + srcW) % srcW, ((y0 + dy) % srcH + srcH) % srcH);
+					float weight = (dx ? fx : 1 - fx) * (dy ? fy : 1 - fy);
+					c += glm::vec3(p.r, p.g, p.b) * weight;
+				}
+			}
+			current[y * w + x] = c;
+		}
+	}
+
+	while (true) {
+		Level level;
+		level.width = w;
+		level.height = h;
+		level.logBlock = log2Int(min(w, h));
+		level.texels.resize(w * h);
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				glm::vec3 c = current[y * w + x];
+				level.at(x, y) = { (unsigned char)(c.x + 0.5f), (unsigned char)(c.y + 0.5f), (unsigned char)(c.z + 0.5f), 255 };
+			}
+		}
+		levels.push_back(level);
+		if (w == 1 && h == 1) break;
+
+		int nw = max(1, w / 2);
+		int nh = max(1, h / 2);
+		vector<glm::vec3> next(nw * nh);
+		for (int y = 0; y < nh; y++) {
+			for (int x = 0; x < nw; x++) {
+				int x0 = 2 * x, x1 = min(2 * x + 1, w - 1);
+				int y0 = 2 * y, y1 = min(2 * y + 1, h - 1);
+				next[y * nw + x] = (current[y0 * w + x0] + current[y0 * w + x1] + current[y1 * w + x0] + current[y1 * w + x1]) / 4.0f;
+			}
+		}
+		current.swap(next);
+		w = nw;
+		h = nh;
+	}
+}
+
+size_t MipTexture::getMemoryUsage() {
+	size_t bytes = levels.capacity() * sizeof(Level);
+	for (Level &level : levels) bytes += level.texels.capacity() * sizeof(Texel);
+	return bytes;
+}
+
+// Bilinear filter within one level; (x, y) are in that level's texels
+//
+glm::vec3 MipTexture::bilinear(Level &level, float x, float y) {
+	x -= 0.5f;
+	y -= 0.5f;
+	int x0 = floor(x);
+	int y0 = floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+	int maskX = level.width - 1;
+	int maskY = level.height - 1;
+
+	Texel &t00 = level.at(x0 & maskX, y0 & maskY);
+	Texel &t10 = level.at((x0 + 1) & maskX, y0 & maskY);
+	Texel &t01 = level.at(x0 & maskX, (y0 + 1) & maskY);
+	Texel &t11 = level.at((x0 + 1) & maskX, (y0 + 1) & maskY);
+
+	glm::vec3 top = glm::mix(glm::vec3(t00.r, t00.g, t00.b), glm::vec3(t10.r, t10.g, t10.b), fx);
+	glm::vec3 bottom = glm::mix(glm::vec3(t01.r, t01.g, t01.b), glm::vec3(t11.r, t11.g, t11.b), fx);
+	return glm::mix(top, bottom, fy);
+}
+
+// Trilinear sample: pick the pair of levels whose texel size brackets the footprint and blend between them
+//
+ofColor MipTexture::sample(float x, float y, float footprint) {
+	if (levels.empty() || !std::isfinite(x) || !std::isfinite(y)) return ofColor::black;
+	x *= scaleX;
+	y *= scaleY;
+	footprint *= max(scaleX, scaleY);
+
+	// wrap into one repeat of the texture before anything becomes an int; grazing hits far out on an infinite plane
+	// give coordinates too big for one. fmod is exact, so this doesn't move the sample.
+	float w = levels[0].width, h = levels[0].height;
+	x = std::fmod(x, w);
+	y = std::fmod(y, h);
+	if (x < 0) x += w;
+	if (y < 0) y += h;
+
+	float lod = (footprint > 1) ? log2(footprint) : 0;
+	lod = min(lod, (float)(levels.size() - 1));
+	int l0 = (int)lod;
+	float f = lod - l0;
+
+	glm::vec3 c = sampleLevel(l0, x, y);
+	if (f > 0 && l0 + 1 < levels.size()) c = glm::mix(c, sampleLevel(l0 + 1, x, y), f);
+	return ofColor(c.x, c.y, c.z);
+}
+
+// Bilinear sample of level l, with (x, y) given in level 0 texels
+//
+glm::vec3 MipTexture::sampleLevel(int l, float x, float y) {
+	Level &level = levels[l];
+	return bilinear(level, x * level.width / levels[0].width, y * level.height / levels[0].height);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Mipmapped texture used by textured planes when ray tracing.
+// At load time the image is resampled to power-of-two dimensions and a chain of box-filtered mip levels is built.
+// Each level is stored in Morton (Z-curve) order so the 2x2 texel neighborhoods read by bilinear filtering
+// sit close together in memory, and wrapping for tiling is a bit mask instead of fmod().
+
+struct Texel {
+	unsigned char r, g, b, a;
+};
+
+//  Tiled, mipmapped copy of an ofImage with trilinear filtering
+//
+class MipTexture {
+public:
+	void build(const ofImage &image);
+	bool isBuilt() { return !levels.empty(); }
+
+	// (x, y) are in texels of the original image, with y = 0 at the top; both wrap around.
+	// footprint is how many original texels one pixel covers at the hit point, and chooses the mip level.
+	ofColor sample(float x, float y, float footprint);
+
+	int getNumLevels() { return levels.size(); }
+	size_t getMemoryUsage();
+
+private:
+	struct Level {
+		int width, height;
+		int logBlock;				// log2 of the square Morton block size, min(width, height)
+		vector<Texel> texels;
+
+		Texel &at(int x, int y);	// x and y must already be wrapped into range
+	};
+
+	glm::vec3 bilinear(Level &level, float x, float y);
+	glm::vec3 sampleLevel(int l, float x, float y);
+
+	vector<Level> levels;
+	float scaleX = 1, scaleY = 1;	// original image texels -> level 0 texels
+};
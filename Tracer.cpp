@@ -0,0 +1,111 @@
+#include "Tracer.h"
+
+std::atomic<bool> Tracer::enabled(false);
+std::chrono::steady_clock::time_point Tracer::epoch = std::chrono::steady_clock::now();
+std::mutex Tracer::buffersMutex;
+vector<unique_ptr<Tracer::ThreadBuffer>> Tracer::buffers;
+thread_local Tracer::ThreadBuffer *Tracer::threadBuffer = NULL;
+thread_local string Tracer::threadName;
+
+// Escape a string so it can be written inside a JSON string literal
+//
+static string jsonEscape(const string &s) {
+	string result;
+	for (char c : s) {
+		if (c == '"' || c == '\\') result += '\\';
+		if (c == '\n') { result += "\\n"; continue; }
+		result += c;
+	}
+	return result;
+}
+
+// Each thread gets its own buffer the first time it records something, so recording only takes that buffer's lock,
+// and threads that never record while tracing is on never get one. Buffers are never freed (only emptied), so the
+// thread_local pointer stays valid between traces.
+//
+Tracer::ThreadBuffer *Tracer::getThreadBuffer() {
+	if (!threadBuffer) {
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		buffers.push_back(make_unique<ThreadBuffer>());
+		threadBuffer = buffers.back().get();
+		threadBuffer->tid = buffers.size();
+		threadBuffer->name = threadName.empty() ? "thread " + ofToString(threadBuffer->tid) : threadName;
+	}
+	return threadBuffer;
+}
+
+void Tracer::start() {
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	for (auto &b : buffers) {
+		std::lock_guard<std::mutex> bufferLock(b->mutex);
+		b->events.clear();
+	}
+	epoch = std::chrono::steady_clock::now();
+	enabled = true;
+	cout << "tracing started" << endl;
+}
+
+void Tracer::stop() {
+	enabled = false;
+}
+
+int64_t Tracer::now() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Tracer::record(const char *name, const char *category, int64_t start, int64_t duration, string args) {
+	ThreadBuffer *buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock(buffer->mutex);
+	buffer->events.push_back({ name, category, start, duration, args });
+}
+
+// Naming a thread doesn't give it a buffer; the name is used once it has one
+//
+void Tracer::setThreadName(string name) {
+	threadName = name;
+	if (threadBuffer) {
+		std::lock_guard<std::mutex> lock(threadBuffer->mutex);
+		threadBuffer->name = name;
+	}
+}
+
+// Write all recorded events in the Chrome trace-event format ("X" complete events plus thread name metadata).
+// Each buffer is copied under its own lock, so threads still inside a scope can keep recording meanwhile.
+//
+bool Tracer::save(string fileName) {
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	ofstream out(ofToDataPath(fileName));
+	if (!out) {
+		cout << "could not write trace to " << fileName << endl;
+		return false;
+	}
+
+	int count = 0;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	for (auto &b : buffers) {
+		string name;
+		vector<TraceEvent> events;
+		{
+			std::lock_guard<std::mutex> bufferLock(b->mutex);
+			name = b->name;
+			events = b->events;
+		}
+		if (events.empty()) continue;
+		if (!first) out << ",\n";
+		first = false;
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+			<< ",\"args\":{\"name\":\"" << jsonEscape(name) << "\"}}";
+		for (const TraceEvent &e : events) {
+			out << ",\n{\"name\":\"" << jsonEscape(e.name) << "\",\"cat\":\"" << jsonEscape(e.category)
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid << ",\"ts\":" << e.start << ",\"dur\":" << e.duration;
+			if (!e.args.empty()) out << ",\"args\":{" << e.args << "}";
+			out << "}";
+			count++;
+		}
+	}
+	out << "\n]}\n";
+
+	cout << "trace saved as bin/data/" << fileName << " (" << count << " events)" << endl;
+	return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+#include <chrono>
+
+// Timeline tracing of the render, load, and save phases.
+// Code is marked up with TRACE_SCOPE, which records how long the enclosing block took on the calling thread, or
+// TRACE_SCOPE_ARGS, which also attaches args (only built while tracing is on).
+// Events are kept in per-thread buffers and written out as a Chrome trace-event JSON file,
+// which can be opened in chrome://tracing or ui.perfetto.dev to look at stalls and load imbalance.
+// While tracing is off a scope costs one relaxed load of a flag; defining RT_NO_TRACING compiles them out entirely.
+
+struct TraceEvent {
+	const char *name;
+	const char *category;
+	int64_t start;		// microseconds since the trace started
+	int64_t duration;
+	string args;		// optional JSON object body, e.g. "\"x\":0,\"y\":32"
+};
+
+//  Global trace recorder, one event buffer per thread
+//
+class Tracer {
+public:
+	static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+	static void start();					// clear any old events and start recording
+	static void stop();
+	static bool save(string fileName);		// write everything recorded so far as a trace-event JSON file
+
+	static int64_t now();
+	static void record(const char *name, const char *category, int64_t start, int64_t duration, string args = "");
+	static void setThreadName(string name);
+
+private:
+	struct ThreadBuffer {
+		std::mutex mutex;		// only the owning thread and save/start take it, so recording rarely waits
+		int tid;
+		string name;
+		vector<TraceEvent> events;
+	};
+	static ThreadBuffer *getThreadBuffer();
+
+	static thread_local ThreadBuffer *threadBuffer;
+	static thread_local string threadName;		// kept here until the thread first records something
+
+	static std::atomic<bool> enabled;
+	static std::chrono::steady_clock::time_point epoch;
+	static std::mutex buffersMutex;
+	static vector<unique_ptr<ThreadBuffer>> buffers;
+};
+
+//  Records a complete event covering the lifetime of the scope
+//
+class TraceScope {
+public:
+	TraceScope(const char *name, const char *category) {
+		if (!Tracer::isEnabled()) return;
+		this->name = name;
+		this->category = category;
+		start = Tracer::now();
+	}
+	~TraceScope() {
+		if (name) Tracer::record(name, category, start, Tracer::now() - start, args);
+	}
+
+	bool isActive() { return name != NULL; }	// check before building args, so disabled scopes don't pay for the string
+	void setArgs(string a) { args = a; }
+
+private:
+	const char *name = NULL;
+	const char *category = NULL;
+	int64_t start = 0;
+	string args;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef RT_NO_TRACING
+#define TRACE_SCOPE(name, category)
+#define TRACE_SCOPE_ARGS(name, category, ...)
+#else
+#define TRACE_SCOPE(name, category) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, category)
+#define TRACE_SCOPE_ARGS(name, category, ...) TRACE_SCOPE(name, category); \
+	if (TRACE_CONCAT(traceScope, __LINE__).isActive()) TRACE_CONCAT(traceScope, __LINE__).setArgs(__VA_ARGS__)
+#endif
@@ -0,0 +1,167 @@
+#include "Viewport.h"
+#include "ofApp.h"
+
+void ViewCamera::set(ofCamera &cam, float aspect) {
+	position = cam.getPosition();
+	xAxis = cam.getXAxis();
+	yAxis = cam.getYAxis();
+	zAxis = cam.getZAxis();
+	tanHalfFov = tan(glm::radians(cam.getFov() / 2));
+	this->aspect = aspect;
+}
+
+Ray ViewCamera::getRay(float u, float v) {
+	glm::vec3 dir = -zAxis + xAxis * ((u * 2 - 1) * tanHalfFov * aspect) + yAxis * ((1 - v * 2) * tanHalfFov);
+	return Ray(position, glm::normalize(dir));
+}
+
+// Project a world-space point into the view; returns false if it's behind the camera
+//
+bool ViewCamera::project(glm::vec3 p, float &u, float &v, float &depth) {
+	glm::vec3 d = p - position;
+	float z = -glm::dot(d, zAxis);
+	if (z <= 0) return false;
+	u = (glm::dot(d, xAxis) / (z * tanHalfFov * aspect) + 1) / 2;
+	v = (1 - glm::dot(d, yAxis) / (z * tanHalfFov)) / 2;
+	depth = glm::length(d);
+	return true;
+}
+
+bool ViewCamera::operator==(const ViewCamera &other) const {
+	return position == other.position && xAxis == other.xAxis && yAxis == other.yAxis && zAxis == other.zAxis
+		&& tanHalfFov == other.tanHalfFov && aspect == other.aspect;
+}
+
+// History buffers and the displayed image
+//
+size_t Viewport::getMemoryUsage() {
+	return color.capacity() * sizeof(glm::vec3) + sampleCount.capacity() * sizeof(int) + worldPos.capacity() * sizeof(glm::vec3)
+		+ depth.capacity() * sizeof(float) + objects.capacity() * sizeof(SceneObject *) + image.getPixels().getTotalBytes();
+}
+
+void Viewport::allocate(int w, int h) {
+	width = w;
+	height = h;
+	color.assign(w * h, glm::vec3(0, 0, 0));
+	sampleCount.assign(w * h, 0);
+	worldPos.assign(w * h, glm::vec3(0, 0, 0));
+	depth.assign(w * h, numeric_limits<float>::infinity());
+	objects.assign(w * h, NULL);
+	image.allocate(w, h, OF_IMAGE_COLOR);
+}
+
+// Scatter every pixel that saw an object into the new view at its hit point, keeping the nearest one where
+// several land on the same pixel. Pixels nothing lands on are left empty to be traced.
+//
+void Viewport::reproject(ViewCamera &to) {
+	TRACE_SCOPE("viewport reproject", "render");
+	int n = width * height;
+	vector<glm::vec3> newColor(n, glm::vec3(0, 0, 0));
+	vector<int> newCount(n, 0);
+	vector<glm::vec3> newPos(n, glm::vec3(0, 0, 0));
+	vector<float> newDepth(n, numeric_limits<float>::infinity());
+	vector<SceneObject *> newObjects(n, NULL);
+
+	for (int k = 0; k < n; k++) {
+		if (sampleCount[k] == 0 || !objects[k]) continue;
+		float u, v, d;
+		if (!to.project(worldPos[k], u, v, d)) continue;
+		int i = u * width;
+		int j = v * height;
+		if (u < 0 || v < 0 || i >= width || j >= height) continue;
+
+		int nk = j * width + i;
+		if (d >= newDepth[nk]) continue;
+		newColor[nk] = color[k];
+		newCount[nk] = min(sampleCount[k], movingHistory);
+		newPos[nk] = worldPos[k];
+		newDepth[nk] = d;
+		newObjects[nk] = objects[k];
+	}
+
+	color.swap(newColor);
+	sampleCount.swap(newCount);
+	worldPos.swap(newPos);
+	depth.swap(newDepth);
+	objects.swap(newObjects);
+}
+
+// Bring the viewport up to date with the camera and scene, tracing only the pixels that need it
+//
+void Viewport::update(ofApp *app, ofCamera &cam, int w, int h) {
+	TRACE_SCOPE("viewport update", "render");
+	w = max(1, w);
+	h = max(1, h);
+	ViewCamera view;
+	view.set(cam, w / (float)h);
+
+	bool resized = (w != width || h != height);
+	if (resized) allocate(w, h);
+
+	uint64_t signature = app->sceneSignature();
+	if (signature != sceneSignature) {		// something in the scene changed, so none of the history is valid
+		sampleCount.assign(width * height, 0);
+		sceneSignature = signature;
+		converged = false;
+	}
+
+	bool moved = !(view == camera);
+	if (moved || resized) converged = false;
+	if (converged) return;		// nothing to trace, so don't even wake the render threads
+	if (moved && !resized) reproject(view);
+	camera = view;
+	frame++;
+	int phase = frame % 4;
+
+	app->prepareRender(view.position, 2 * view.tanHalfFov / height, true);
+	app->printProgress = false;
+	app->forEachTile(width, height, "viewport", [&](int x0, int y0, int x1, int y1) {
+		for (int j = y0; j < y1; j++) {
+			for (int i = x0; i < x1; i++) {
+				int k = j * width + i;
+				int count = sampleCount[k];
+				bool trace;
+				if (count == 0) trace = true;
+				else if (moved) trace = ((i & 1) + 2 * (j & 1)) == phase;
+				else trace = count < maxSamples;
+				if (!trace) continue;
+
+				// a still camera jitters each new sample within the pixel, so the average also anti-aliases
+				float ju = 0.5, jv = 0.5;
+				if (!moved && count > 0) {
+					uint32_t seed = (uint32_t)(k * 2654435761u) ^ (uint32_t)(count * 0x68e31da4);
+					ju = (seed & 0xffff) / 65536.0f;
+					jv = (seed >> 16) / 65536.0f;
+				}
+				Ray ray = camera.getRay((i + ju) / width, (j + jv) / height);
+
+				HitRecord hit;
+				ofColor c = ofColor::darkGray;
+				if (app->closestHit(ray, hit)) c = app->shadeHit(ray, hit);
+				else hit.obj = NULL;
+
+				if (hit.obj != objects[k]) count = 0;		// something else is in this pixel now; drop its history
+				else if (moved) count = min(count, movingHistory);
+				color[k] = (color[k] * (float)count + glm::vec3(c.r, c.g, c.b)) / (float)(count + 1);
+				sampleCount[k] = count + 1;
+				objects[k] = hit.obj;
+				if (hit.obj) {
+					worldPos[k] = hit.point;
+					depth[k] = hit.dist;
+				}
+			}
+		}
+	});
+	app->printProgress = true;
+
+	ofPixels &pixels = image.getPixels();
+	converged = true;
+	for (int j = 0; j < height; j++) {
+		for (int i = 0; i < width; i++) {
+			glm::vec3 c = color[j * width + i];
+			pixels.setColor(i, j, ofColor(c.x, c.y, c.z));
+			if (sampleCount[j * width + i] < maxSamples) converged = false;
+		}
+	}
+	image.update();
+}
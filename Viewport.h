@@ -0,0 +1,57 @@
+#pragma once
+
+#include "SceneObject.h"
+
+// Low resolution ray-traced view of the scene from the interactive camera, refreshed every frame.
+// While the camera holds still, every frame adds one more jittered sample per pixel to a running average until
+// the image converges, after which frames cost nothing. When the camera moves, last frame's samples are
+// reprojected through their world-space hit points into the new view, and only the holes plus a quarter of the
+// pixels (in a rotating 2x2 pattern) are traced again, so the view keeps up while it's being dragged around.
+
+class ofApp;
+
+//  Pinhole camera basis copied out of an ofCamera, so the render threads never touch the ofCamera itself
+//
+struct ViewCamera {
+	glm::vec3 position;
+	glm::vec3 xAxis, yAxis, zAxis;		// looks down -zAxis
+	float tanHalfFov = 1;
+	float aspect = 1;
+
+	void set(ofCamera &cam, float aspect);
+	Ray getRay(float u, float v);		// u runs left to right and v top to bottom, both in [0, 1]
+	bool project(glm::vec3 p, float &u, float &v, float &depth);
+	bool operator==(const ViewCamera &other) const;
+};
+
+//  Progressive ray-traced viewport
+//
+class Viewport {
+public:
+	void update(ofApp *app, ofCamera &cam, int width, int height);
+	void draw(float w, float h) { if (image.isAllocated()) image.draw(0, 0, w, h); }
+
+	size_t getMemoryUsage();
+
+	int maxSamples = 64;		// stop refining a still image after this many samples per pixel
+	int movingHistory = 2;		// samples of history a pixel keeps while the camera moves, to limit ghosting
+
+private:
+	void allocate(int w, int h);
+	void reproject(ViewCamera &to);
+
+	int width = 0, height = 0;
+	int frame = 0;
+	bool converged = false;		// every pixel has maxSamples samples and nothing has changed since
+	uint64_t sceneSignature = 0;
+	ViewCamera camera;
+
+	// per-pixel history, indexed [j * width + i]
+	vector<glm::vec3> color;			// running average of the samples so far
+	vector<int> sampleCount;			// 0 means nothing is known about the pixel
+	vector<glm::vec3> worldPos;			// hit point of the latest sample
+	vector<float> depth;
+	vector<SceneObject *> objects;
+
+	ofImage image;
+};
@@ -0,0 +1,156 @@
+#include "Wavefront.h"
+#include "ofApp.h"
+
+static std::atomic<uint64_t> shadowRayCount(0);
+static std::atomic<uint64_t> shadowMicros(0);
+
+void WavefrontRenderer::resetStats() {
+	shadowRayCount = 0;
+	shadowMicros = 0;
+}
+
+void WavefrontRenderer::getShadowStats(uint64_t &rays, uint64_t &micros) {
+	rays = shadowRayCount;
+	micros = shadowMicros;
+}
+
+// Spread the low 10 bits of n out to every third bit, so three of them can be interleaved into a Morton code
+//
+static uint32_t part1By2(uint32_t n) {
+	n &= 0x000003ff;
+	n = (n ^ (n << 16)) & 0xff0000ff;
+	n = (n ^ (n << 8)) & 0x0300f00f;
+	n = (n ^ (n << 4)) & 0x030c30c3;
+	n = (n ^ (n << 2)) & 0x09249249;
+	return n;
+}
+
+void WavefrontRenderer::renderTile(ofApp *app, int x0, int y0, int x1, int y1) {
+	TRACE_SCOPE_ARGS("wavefront tile", "render", "\"x\":" + ofToString(x0) + ",\"y\":" + ofToString(y0));
+
+	this->app = app;
+	this->x0 = x0;
+	this->y0 = y0;
+	this->x1 = x1;
+	this->y1 = y1;
+
+	int count = (x1 - x0) * (y1 - y0);
+	ambient.assign(count, ofColor::darkGray);	// pixels that hit nothing keep the background color
+	lightSum.assign(count, glm::vec3(0, 0, 0));
+	objects.assign(count, NULL);
+
+	generate();
+	extend();
+	shade();
+	if (app->sortShadowRays) sortShadowRays();
+
+	auto start = std::chrono::steady_clock::now();
+	shadow();
+	shadowMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	shadowRayCount += shadowRays.size();
+
+	write();
+}
+
+// One ray through the center of every pixel in the tile
+//
+void WavefrontRenderer::generate() {
+	rays.clear();
+	rayPixels.clear();
+	int w = x1 - x0;
+	for (int j = y0; j < y1; j++) {
+		for (int i = x0; i < x1; i++) {
+			rays.push_back(app->renderCam.getRay((i + 0.5) / app->imageWidth, (j + 0.5) / app->imageHeight));
+			rayPixels.push_back((j - y0) * w + (i - x0));
+		}
+	}
+}
+
+// Find the closest hit for every ray in the queue; rays that miss drop out here
+//
+void WavefrontRenderer::extend() {
+	hits.clear();
+	hitPixels.clear();
+	HitRecord hit;
+	for (int r = 0; r < rays.size(); r++) {
+		if (!app->closestHit(rays[r], hit)) continue;
+		hits.push_back(hit);
+		hitPixels.push_back(rayPixels[r]);
+	}
+}
+
+// Look up the surface color at each hit, add the ambient term, and queue a shadow ray for each light that could add to it
+//
+void WavefrontRenderer::shade() {
+	shadowRays.clear();
+	thread_local vector<LightSample> samples;
+	float power = app->phongPower;
+	for (int h = 0; h < hits.size(); h++) {
+		HitRecord &hit = hits[h];
+		int pixel = hitPixels[h];
+		int r = pixel;		// every pixel has exactly one camera ray, at the same index
+		ofColor diffuse = hit.obj->getColorAt(hit.point, app->pixelFootprint(rays[r], hit));
+		ofColor specular = hit.obj->specularColor;
+
+		objects[pixel] = hit.obj;
+		ambient[pixel] = diffuse * (app->ambientStrength);
+
+		samples.clear();
+		app->sampleLights(hit.point, hit.normal, diffuse, specular, power, samples);
+		glm::vec3 origin = hit.point + (hit.normal * 0.01);
+		for (LightSample &s : samples) shadowRays.push_back({ pixel, origin, s.light, s.color, 0 });
+	}
+}
+
+// Reorder the shadow rays so rays toward the same light, leaving from nearby points in the same general direction,
+// are tested one after another and walk through the same objects and triangles while they're still in cache.
+// Sort order is light, then direction octant, then the Morton code of the origin within the tile's hit bounds.
+//
+void WavefrontRenderer::sortShadowRays() {
+	if (shadowRays.size() < 2) return;
+	TRACE_SCOPE("sort shadow rays", "render");
+
+	glm::vec3 lo = shadowRays[0].origin;
+	glm::vec3 hi = lo;
+	for (ShadowRay &s : shadowRays) {
+		lo = glm::min(lo, s.origin);
+		hi = glm::max(hi, s.origin);
+	}
+	glm::vec3 scale = 1023.0f / glm::max(hi - lo, glm::vec3(0.0001f));
+
+	for (ShadowRay &s : shadowRays) {
+		glm::vec3 d = s.light->position - s.origin;
+		uint64_t octant = (d.x < 0) | ((d.y < 0) << 1) | ((d.z < 0) << 2);
+		glm::vec3 cell = (s.origin - lo) * scale;
+		uint32_t morton = part1By2(cell.x) | (part1By2(cell.y) << 1) | (part1By2(cell.z) << 2);
+		s.key = (octant << 30) | morton;
+	}
+
+	std::sort(shadowRays.begin(), shadowRays.end(), [](const ShadowRay &a, const ShadowRay &b) {
+		if (a.light != b.light) return a.light < b.light;
+		return a.key < b.key;
+	});
+}
+
+void WavefrontRenderer::shadow() {
+	for (ShadowRay &s : shadowRays) {
+		if (!app->castShadows || !s.light->light->isBlocked(s.origin, app->scene)) lightSum[s.pixel] += s.color;
+	}
+}
+
+// Combine the terms the same way phong() does and store the results in the image and the per-pixel buffers
+//
+void WavefrontRenderer::write() {
+	int w = x1 - x0;
+	for (int j = y0; j < y1; j++) {
+		for (int i = x0; i < x1; i++) {
+			int pixel = (j - y0) * w + (i - x0);
+			ofColor color = ambient[pixel];
+			if (objects[pixel]) {
+				glm::vec3 sum = lightSum[pixel];
+				color += ofColor(min(sum.x, 255.0f), min(sum.y, 255.0f), min(sum.z, 255.0f));
+			}
+			app->storeBasePixel(i, j, color, objects[pixel]);
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "LightCuller.h"
+
+// Wavefront ray tracing mode.
+// Instead of following one pixel at a time through intersection, shading and shadow tests, a whole tile of rays
+// moves through each stage together: generate camera rays, extend them to their closest hits, shade the hits
+// (which emits shadow rays), then test all the shadow rays. Each stage loops over one contiguous queue and fills
+// the queue for the next stage, which keeps each loop's code and data small and lets stages be vectorized separately.
+
+class ofApp;
+
+//  A shadow ray waiting to be tested, and what it adds to its pixel if it gets through
+//
+struct ShadowRay {
+	int pixel;				// index into the tile
+	glm::vec3 origin;
+	const LightInfo *light;
+	glm::vec3 color;
+	uint64_t key;			// direction octant (bits 30-32) and origin Morton code, for coherence sorting
+};
+
+//  Staged renderer for one tile at a time; the queues are reused from tile to tile
+//
+class WavefrontRenderer {
+public:
+	void renderTile(ofApp *app, int x0, int y0, int x1, int y1);
+
+	// shadow stage throughput, summed over all threads since the last reset
+	static void resetStats();
+	static void getShadowStats(uint64_t &rays, uint64_t &micros);
+
+private:
+	void generate();
+	void extend();
+	void shade();
+	void sortShadowRays();
+	void shadow();
+	void write();
+
+	ofApp *app;
+	int x0, y0, x1, y1;
+
+	// queues
+	vector<Ray> rays;
+	vector<int> rayPixels;
+	vector<HitRecord> hits;
+	vector<int> hitPixels;
+	vector<ShadowRay> shadowRays;
+
+	// per-pixel results for the tile
+	vector<ofColor> ambient;
+	vector<glm::vec3> lightSum;
+	vector<SceneObject *> objects;
+};
@@ -1,8 +1,40 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "ofAppNoWindow.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+	// "--regress" renders the reference scenes without a window, checks them against
+	// the golden images, and exits with status 1 if any of them changed or are missing.
+	// "--record-golden" does the same renders but writes them as the golden images.
+	if (argc > 1 && (string(argv[1]) == "--regress" || string(argv[1]) == "--record-golden")) {
+		ofSetupOpenGL(std::make_shared<ofAppNoWindow>(), 1024, 768, OF_WINDOW);
+		ofApp *app = new ofApp();
+		app->bHeadless = true;
+		app->bRecordGolden = (string(argv[1]) == "--record-golden");
+		return ofRunApp(app);
+	}
+
+	// "--worker host:port" renders tiles for a distributed render (press n) running at host:port, without a window,
+	// and exits when it's done
+	if (argc > 2 && string(argv[1]) == "--worker") {
+		ofSetupOpenGL(std::make_shared<ofAppNoWindow>(), 1024, 768, OF_WINDOW);
+		ofApp *app = new ofApp();
+		app->bHeadless = true;
+		app->workerAddress = argv[2];
+		return ofRunApp(app);
+	}
+
+	// "--serve port" runs a render server without a window, taking render jobs (press j, or see RenderServer.h)
+	// on port until it's stopped
+	if (argc > 2 && string(argv[1]) == "--serve") {
+		ofSetupOpenGL(std::make_shared<ofAppNoWindow>(), 1024, 768, OF_WINDOW);
+		ofApp *app = new ofApp();
+		app->bHeadless = true;
+		app->servePort = ofToInt(argv[2]);
+		return ofRunApp(app);
+	}
+
 	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
@@ -33,71 +33,585 @@ void RenderCam::drawFrustum() {
 	r4.draw(dist);
 }
 
-// Cast rays out from the camera's perspective to create an image output to a file called raytraced.png
+// Cheap integer hash mapped to [0, 1), so the jittered sample positions are the same every render
+//
+static float hashToUnit(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+// Hash the bits of a point, to seed per-point random choices that stay the same from render to render
+//
+static uint32_t hashPoint(glm::vec3 p) {
+	uint32_t bits[3];
+	memcpy(bits, &p.x, sizeof(bits));
+	return bits[0] ^ (bits[1] * 0x9e3779b9) ^ (bits[2] * 0x85ebca6b);
+}
+
+// Byte count as a short human-readable string
+//
+static string formatBytes(size_t bytes) {
+	if (bytes < 1024) return ofToString(bytes) + " B";
+	if (bytes < 1024 * 1024) return ofToString(bytes / 1024.0, 1) + " kB";
+	return ofToString(bytes / (1024.0 * 1024.0), 1) + " MB";
+}
+
+// Cast rays out from the camera's perspective to create an image, saved to the output file in the background
 //
 void ofApp::rayTrace() {
-	float u, v;
-	glm::vec3 intersectPt, normal;
+	TRACE_SCOPE("rayTrace", "render");
+	renderImage(antiAlias, true);
 
-	for (int i = 0; i < imageWidth; i++) {
-		for (int j = 0; j < imageHeight; j++) {
-			u = (i + 0.5) / imageWidth;
-			v = (j + 0.5) / imageHeight;
+	image.update();
+	cout << "ray trace successful" << endl;
+	saveOutput();
+	bShowImage = true;
 
-			Ray ray = renderCam.getRay(u, v);
-			float distance = numeric_limits<float>::infinity();
-			float closest = distance;
-			ofColor color = ofColor::darkGray;	// default to dark grey if no objects are hit by the ray
+}
 
-			for (SceneObject *obj : scene) {
-				if (obj->isVisible && obj->intersect(ray, intersectPt, normal) ) {
-					if (glm::distance(ray.p, intersectPt) < closest) {	// new closest object
-						closest = glm::distance(ray.p, intersectPt);
-						color = phong(intersectPt, normal, obj->getColorAt(intersectPt), obj->specularColor, phongPower);
+// The output file from the settings panel, with the next unused number added if outputs are numbered
+//
+string ofApp::nextOutputFile() {
+	string fileName = outputFile;
+	if (fileName.empty()) fileName = "raytraced.png";
+	if (!numberOutputs) return fileName;
 
-					}
-				}
+	string ext = ofFilePath::getFileExt(fileName);
+	string base = ofFilePath::removeExt(fileName);
+	string numbered;
+	do {
+		numbered = base + "_" + ofToString(++outputCount, 4, '0') + "." + ext;
+	} while (ofFile::doesFileExist(numbered));
+	return numbered;
+}
+
+// Queue image to be written to the output file; the next render can start before it's done
+//
+void ofApp::saveOutput() {
+	string fileName = nextOutputFile();
+	writer.pngCompression = pngCompression;
+	writer.write(image.getPixels(), fileName);
+	cout << "saving as bin/data/" << fileName << endl;
+}
+
+// Render the frame at largeScale times the resolution a strip of rows at a time, writing each strip straight into a
+// PPM or PFM file, so the whole image is never in memory at once
+//
+void ofApp::renderLarge() {
+	int width = imageWidth * largeScale, height = imageHeight * largeScale;
+	string fileName = nextOutputFile();
+	if (ofToLower(ofFilePath::getFileExt(fileName)) != "pfm") fileName = ofFilePath::removeExt(fileName) + ".ppm";	// the formats that can be streamed
+	int stream = writer.beginStream(fileName, width, height);
+	if (stream < 0) {
+		cout << "couldn't create bin/data/" << fileName << endl;
+		return;
+	}
+
+	TRACE_SCOPE("render large", "render");
+	auto start = std::chrono::steady_clock::now();
+	bool printing = printProgress;
+	printProgress = false;
+	int stripHeight = 128;
+	for (int y = 0; y < height; y += stripHeight) {
+		ofPixels strip;
+		if (!renderRegion(width, height, 0, y, width, stripHeight, strip, antiAlias, true)) break;
+		writer.writeTile(stream, 0, y, std::move(strip));
+		cout << "rows " << y << " to " << min(y + stripHeight, height) << " of " << height << endl;
+	}
+	printProgress = printing;
+	writer.endStream(stream);
+	float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	cout << "large render: " << width << "x" << height << " in " << seconds << "s, streaming to bin/data/" << fileName << endl;
+}
+
+// Render the scene into image at imageWidth x imageHeight. If anti-aliasing is on, a second pass adds extra samples
+// only to pixels sitting on an edge. Returns false if the render deadline passed before every tile was finished.
+//
+bool ofApp::renderImage(bool aa, bool shadows) {
+	return renderCrop(0, 0, imageWidth, imageHeight, aa, shadows);
+}
+
+// Render the region (x, y, w, h) of a width x height frame into pixels, leaving the app's frame size and image alone.
+// The region is in output pixels from the top left and is clipped to the frame; a full-width region is a range of
+// scanlines. Regions rendered separately and put side by side match a render of the whole frame exactly.
+//
+bool ofApp::renderRegion(int width, int height, int x, int y, int w, int h, ofPixels &pixels, bool aa, bool shadows) {
+	int x0 = ofClamp(x, 0, width), y0 = ofClamp(y, 0, height);
+	int x1 = ofClamp(x + w, 0, width), y1 = ofClamp(y + h, 0, height);
+	if (x1 <= x0 || y1 <= y0) return false;
+
+	int savedWidth = imageWidth, savedHeight = imageHeight;
+	ofPixels savedImage = image.getPixels();
+	imageWidth = width;
+	imageHeight = height;
+	bool finished = renderCrop(x0, y0, x1 - x0, y1 - y0, aa, shadows);
+	pixels = image.getPixels();
+
+	imageWidth = savedWidth;
+	imageHeight = savedHeight;
+	image.setFromPixels(savedImage);
+	return finished;
+}
+
+// Render the region (x, y, w, h) of the imageWidth x imageHeight frame into image, which is resized to w x h.
+// The base pass also covers a one pixel border around the region, so edge detection for anti-aliasing at the
+// region's sides sees the same neighbors it would in a render of the whole frame.
+//
+bool ofApp::renderCrop(int x, int y, int w, int h, bool aa, bool shadows) {
+	prepareRender(renderCam.position, renderCam.view.width() / imageWidth / glm::distance(renderCam.position, renderCam.view.position), shadows);
+	cropX0 = x;
+	cropX1 = x + w;
+	cropY0 = imageHeight - (y + h);		// j counts up from the bottom of the frame, like v on the view plane
+	cropY1 = imageHeight - y;
+	bufX0 = max(0, cropX0 - 1);
+	bufY0 = max(0, cropY0 - 1);
+	bufWidth = min(imageWidth, cropX1 + 1) - bufX0;
+	bufHeight = min(imageHeight, cropY1 + 1) - bufY0;
+	if (image.getWidth() != w || image.getHeight() != h) image.allocate(w, h, OF_IMAGE_COLOR);
+	baseColors.assign(bufWidth * bufHeight, ofColor::darkGray);
+	pixelObjects.assign(bufWidth * bufHeight, NULL);
+	objectBufferStamp = 0;
+
+	if (printProgress && !wavefront) cout << "render kernel: " << (kernels.tile ? kernels.name : "general") << endl;
+	for (SceneObject *obj : scene) {
+		Mesh *mesh = dynamic_cast<Mesh *>(obj);
+		if (mesh && printProgress) cout << "mesh level of detail: " << mesh->getActiveLod() << " of " << mesh->getNumLods() - 1 << endl;
+	}
+
+	bool finished;
+	if (wavefront) finished = forEachTile(bufWidth, bufHeight, "base pass (wavefront)", [this](int x0, int y0, int x1, int y1) {
+		renderTileWavefront(x0 + bufX0, y0 + bufY0, x1 + bufX0, y1 + bufY0);
+	});
+	else finished = forEachTile(bufWidth, bufHeight, "base pass", [this](int x0, int y0, int x1, int y1) {
+		renderTile(x0 + bufX0, y0 + bufY0, x1 + bufX0, y1 + bufY0);
+	});
+	if (!finished) return false;
+	if (w == imageWidth && h == imageHeight) {		// picking only looks up whole frames
+		objectBufferStamp = renderViewSignature();
+		objectBufferWidth = imageWidth;
+		objectBufferHeight = imageHeight;
+	}
+
+	if (aa) {
+		std::atomic<int> refined(0);
+		finished = forEachTile(w, h, "anti-aliasing", [this, &refined](int x0, int y0, int x1, int y1) {
+			refined += refineTile(x0 + cropX0, y0 + cropY0, x1 + cropX0, y1 + cropY0);
+		});
+		if (!finished) return false;
+
+		int grid = aaGrid;
+		float cost = (w * h + refined * grid * grid) / (float)(w * h * grid * grid);
+		if (printProgress) cout << "anti-aliasing refined " << refined << " of " << w * h << " pixels, "
+			<< (int)(cost * 100) << "% of the rays of uniform " << grid << "x" << grid << " supersampling" << endl;
+	}
+
+	if (!printProgress) return true;
+
+	size_t sceneBytes, accelBytes, bufferBytes;
+	memoryUsage(sceneBytes, accelBytes, bufferBytes);
+	cout << "memory: " << formatBytes(sceneBytes) << " in scene objects, " << formatBytes(accelBytes) << " in acceleration structures, "
+		<< formatBytes(bufferBytes) << " in render buffers" << endl;
+
+	uint64_t chunkLoads, chunkEvictions;
+	ChunkCache::get().getStats(chunkLoads, chunkEvictions);
+	if (chunkLoads) cout << "out-of-core meshes: " << chunkLoads << " chunks mapped and " << chunkEvictions << " evicted so far" << endl;
+
+	uint64_t shadowTests, shadowHits;
+	Light::getShadowCacheStats(shadowTests, shadowHits);
+	if (shadowTests) cout << "shadow occluder cache: " << shadowHits << " of " << shadowTests << " shadow tests answered by the cached occluder ("
+		<< (int)(100.0 * shadowHits / shadowTests) << "% hit rate)" << endl;
+
+	uint64_t shadowRays, shadowMicros;
+	WavefrontRenderer::getShadowStats(shadowRays, shadowMicros);
+	if (shadowRays) cout << "wavefront shadow stage: " << shadowRays << " rays in " << shadowMicros / 1000 << " ms of thread time ("
+		<< (shadowMicros ? shadowRays / (double)shadowMicros : 0) << " million rays/s per thread)" << endl;
+	return true;
+}
+
+// Render a close-up of part of the frame at detailScale times the resolution, saved as detail.png. The part is a
+// quarter of the frame's width and height, centered on the mouse when looking through the render camera and on the
+// middle of the frame otherwise.
+//
+void ofApp::renderDetail() {
+	float u = 0.5, v = 0.5;
+	if (theCam == &previewCam) {
+		glm::vec3 p = theCam->screenToWorld(glm::vec3(ofGetMouseX(), ofGetMouseY(), 0));
+		if (!viewPlaneAt(Ray(p, glm::normalize(p - theCam->getPosition())), u, v)) u = v = 0.5;
+	}
+
+	int width = imageWidth * detailScale;
+	int height = imageHeight * detailScale;
+	int w = width / 4, h = height / 4;
+	int x = ofClamp(u * width - w / 2, 0, width - w);
+	int y = ofClamp((1 - v) * height - h / 2, 0, height - h);		// v counts up, image rows count down
+
+	ofPixels detail;
+	auto start = std::chrono::steady_clock::now();
+	if (!renderRegion(width, height, x, y, w, h, detail, antiAlias, true)) return;
+	float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	writer.write(detail, "detail.png");
+	cout << "detail: " << w << "x" << h << " pixels at (" << x << ", " << y << ") of a " << width << "x" << height
+		<< " frame in " << seconds << "s, saving as bin/data/detail.png" << endl;
+}
+
+// Render the frame on worker processes (see Distributed.h) and save it to the output file like rayTrace() does
+//
+void ofApp::renderDistributed() {
+	RenderCoordinator coordinator;
+	coordinator.port = renderPort;
+	coordinator.localWorkers = localWorkers;
+	ofPixels pixels;
+	if (!coordinator.render(this, pixels, antiAlias)) return;
+
+	image.setFromPixels(pixels);
+	cout << "distributed ray trace successful" << endl;
+	saveOutput();
+	bShowImage = true;
+}
+
+// Send the frame as a job to the render server (see RenderServer.h) listening on the render port, and save the image
+// to the output file like rayTrace() does
+//
+void ofApp::renderOnServer() {
+	ofPixels pixels;
+	auto start = std::chrono::steady_clock::now();
+	if (!requestRender(this, "127.0.0.1:" + ofToString((int)renderPort), imageWidth, imageHeight, antiAlias, pixels)) return;
+	float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+	image.setFromPixels(pixels);
+	cout << "server ray trace successful in " << seconds << "s" << endl;
+	saveOutput();
+	bShowImage = true;
+}
+
+// Set up everything shading depends on before tracing a batch of pixels from a camera at eye,
+// where each pixel covers pixelAngle radians
+//
+void ofApp::prepareRender(glm::vec3 eye, float pixelAngle, bool shadows) {
+	eyePosition = eye;
+	this->pixelAngle = pixelAngle;
+	castShadows = shadows;
+	lightCuller.build(lights, lightFalloff);
+	Light::resetShadowCache();
+	WavefrontRenderer::resetStats();
+	ChunkCache::get().setBudget((size_t)meshCacheBudget * 1024 * 1024);
+
+	for (SceneObject *obj : scene) {
+		Mesh *mesh = dynamic_cast<Mesh *>(obj);
+		if (mesh) mesh->selectLod(eye, pixelAngle * lodError);
+	}
+
+	sceneLists.build(scene, lights);
+	kernels = specializedKernels ? selectKernels(sceneLists, shadows) : RenderKernels();
+}
+
+// Split a width x height image into square tiles and hand them out to the render threads as they finish,
+// returning once tileFunc has been called on every tile. If a render deadline is set, the threads stop
+// picking up new tiles once it passes, and false is returned.
+//
+bool ofApp::forEachTile(int width, int height, string passName, std::function<void(int, int, int, int)> tileFunc) {
+	int tilesX = (width + tileSize - 1) / tileSize;
+	int tilesY = (height + tileSize - 1) / tileSize;
+	int numTiles = tilesX * tilesY;
+	std::atomic<int> nextTile(0);
+	std::atomic<int> pixelsDone(0);
+	std::atomic<bool> timedOut(false);
+	std::mutex printMutex;
+
+	renderPool.run(renderThreads, [&](int threadIndex) {
+		for (int t = nextTile++; t < numTiles; t = nextTile++) {
+			if (bDeadline && std::chrono::steady_clock::now() > renderDeadline) {
+				timedOut = true;
+				break;
 			}
-			image.setColor(i, imageHeight - j - 1, color);
+			int x0 = (t % tilesX) * tileSize;
+			int y0 = (t / tilesX) * tileSize;
+			int x1 = min(x0 + tileSize, width);
+			int y1 = min(y0 + tileSize, height);
+			tileFunc(x0, y0, x1, y1);
 
+			int done = (pixelsDone += (x1 - x0) * (y1 - y0));
+			if (!printProgress) continue;
+			std::lock_guard<std::mutex> lock(printMutex);
+			cout << passName << ": completed " << done << " pixels out of " << width * height << endl;
 		}
+		Light::flushShadowCacheStats();
+		ChunkCache::unpinThread();
+	});
+	return !timedOut;
+}
 
-		cout << "Completed " << (i+1) * imageHeight << " pixels out of " << imageHeight * imageWidth << endl;
+// Render the best preview possible within the wall-clock budget. Works up a ladder of quality steps,
+// from a low resolution unshadowed image to full resolution with anti-aliasing, timing each step to
+// predict whether the next one will fit in the time left. The last step that finished is shown and
+// saved as preview.png (unless save is false), along with a report of the quality reached.
+//
+void ofApp::previewRender(float budgetSeconds, bool save) {
+	TRACE_SCOPE("previewRender", "render");
+	struct Step { int divisor; bool shadows; bool aa; };
+	const Step ladder[] = { { 8, false, false }, { 8, true, false }, { 4, true, false }, { 2, true, false }, { 1, true, false }, { 1, true, true } };
+
+	int fullWidth = imageWidth;
+	int fullHeight = imageHeight;
+	auto start = std::chrono::steady_clock::now();
+	renderDeadline = start + std::chrono::microseconds((int64_t)(budgetSeconds * 1e6));
+	bDeadline = true;
+	bool printing = printProgress;
+	printProgress = false;
+
+	ofPixels best;
+	int bestStep = -1;
+	float secondsPerPixel[2] = { 0, 0 };		// measured cost of the last finished step, without and with shadows
+	for (int s = 0; s < sizeof(ladder) / sizeof(ladder[0]); s++) {
+		const Step &step = ladder[s];
+		int w = max(1, fullWidth / step.divisor);
+		int h = max(1, fullHeight / step.divisor);
 
+		// predict from the throughput measured so far; with no measurement for shadows yet, guess they cost 3x
+		float rate = secondsPerPixel[step.shadows];
+		if (rate == 0) rate = secondsPerPixel[0] * 3;
+		float predicted = rate * w * h * (step.aa ? 2 : 1);
+		float remaining = std::chrono::duration<float>(renderDeadline - std::chrono::steady_clock::now()).count();
+		if (bestStep >= 0 && predicted > remaining) break;
+
+		imageWidth = w;
+		imageHeight = h;
+		image.allocate(w, h, OF_IMAGE_COLOR);
+		auto stepStart = std::chrono::steady_clock::now();
+		if (!renderImage(step.aa, step.shadows) && bestStep >= 0) break;	// ran out of time partway; keep the last full step
+
+		float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - stepStart).count();
+		if (!step.aa) secondsPerPixel[step.shadows] = seconds / (w * h);
+		best = image.getPixels();
+		bestStep = s;
 	}
 
-	image.update();
+	bDeadline = false;
+	printProgress = printing;
+	imageWidth = fullWidth;
+	imageHeight = fullHeight;
 
-	image.save("raytraced.png");
-	cout << "ray trace successful: output saved as bin/data/raytraced.png" << endl;
+	const Step &reached = ladder[bestStep];
+	image.setFromPixels(best);
+	if (save) writer.write(best, "preview.png");
+	image.resize(fullWidth, fullHeight);		// scale up so it displays like a full render
 	bShowImage = true;
 
+	float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	cout << "preview finished in " << elapsed << "s of a " << budgetSeconds << "s budget: "
+		<< best.getWidth() << "x" << best.getHeight() << " (1/" << reached.divisor << " resolution), shadows "
+		<< (reached.shadows ? "on" : "off") << ", anti-aliasing " << (reached.aa ? "on" : "off")
+		<< " - quality step " << bestStep + 1 << " of " << sizeof(ladder) / sizeof(ladder[0]) << (save ? ", saved as bin/data/preview.png" : "") << endl;
 }
 
-// Apply a shiny Blinn-Phong shader effect to a color, given the point on the scene object, the normal, the unshaded color (diffuse), the highlight color (specular), and the strength of the effect
+// Find the closest object the ray hits and shade it, or return the background color if it hits nothing.
+// The object that was hit (or NULL) is passed back through hitObj.
+//
+ofColor ofApp::traceRay(const Ray &ray, SceneObject *&hitObj) {
+	if (kernels.ray) return kernels.ray(this, ray, hitObj);
+
+	HitRecord hit;
+	if (!closestHit(ray, hit)) {
+		hitObj = NULL;
+		return ofColor::darkGray;	// default to dark grey if no objects are hit by the ray
+	}
+	hitObj = hit.obj;
+	return shadeHit(ray, hit);
+}
+
+// Shade the closest hit found along a ray
+//
+ofColor ofApp::shadeHit(const Ray &ray, const HitRecord &hit) {
+	return phong(hit.point, hit.normal, hit.obj->getColorAt(hit.point, pixelFootprint(ray, hit)), hit.obj->specularColor, phongPower);
+}
+
+// Find the closest visible object the ray hits; returns false if it hits nothing
 //
-ofColor ofApp::phong(const glm::vec3 &p, const glm::vec3 &norm, const ofColor diffuse, const ofColor specular, float power) {	ofColor result = lambert(p, norm, diffuse);	for (Light *l : lights) {
-		if (!l->isBlocked(p + (norm * 0.01), scene)) {
-			result += specular * (l->intensity / lightFalloff) * glm::pow(max((float)0, glm::dot(norm, glm::normalize(l->position - p + renderCam.position - p))), power);
+bool ofApp::closestHit(const Ray &ray, HitRecord &hit) {
+	glm::vec3 intersectPt, normal;
+	hit.obj = NULL;
+	hit.dist = numeric_limits<float>::infinity();
+
+	for (SceneObject *obj : scene) {
+		if (obj->isVisible && obj->intersect(ray, intersectPt, normal)) {
+			float dist = glm::distance(ray.p, intersectPt);
+			if (dist < hit.dist) {	// new closest object
+				hit.dist = dist;
+				hit.point = intersectPt;
+				hit.normal = normal;
+				hit.obj = obj;
+			}
 		}
-	}	return result;}
+	}
+	return hit.obj != NULL;
+}
 
-// Apply a matte Lambert shading effect to a color, given the point on the scene object, the normal, and the unshaded color (diffuse)
+// World-space width of the pixel at the hit point: the pixel's cone widens with distance,
+// and stretches across surfaces seen at a glancing angle
 //
-ofColor ofApp::lambert(const glm::vec3 &p, const glm::vec3 &norm, const ofColor diffuse) {
-	ofColor result = diffuse * (ambientStrength);	// ambient light level
-	for (Light *l : lights) {
-		if (!l->isBlocked(p + (norm * 0.01), scene)) {
-			result += diffuse * (l->intensity / lightFalloff) * max((float)0, glm::dot(norm, glm::normalize(l->position - p)));
+float ofApp::pixelFootprint(const Ray &ray, const HitRecord &hit) {
+	return hit.dist * pixelAngle / max(0.05f, abs(glm::dot(ray.d, hit.normal)));
+}
+
+// Trace one ray through the center of every pixel in the rectangle [x0, x1) x [y0, y1) of the output image
+//
+void ofApp::renderTile(int x0, int y0, int x1, int y1) {
+	if (kernels.tile) {
+		kernels.tile(this, x0, y0, x1, y1);
+		return;
+	}
+
+	TRACE_SCOPE_ARGS("tile", "render", "\"x\":" + ofToString(x0) + ",\"y\":" + ofToString(y0));
+
+	for (int i = x0; i < x1; i++) {
+		for (int j = y0; j < y1; j++) {
+			Ray ray = renderCam.getRay((i + 0.5) / imageWidth, (j + 0.5) / imageHeight);
+			SceneObject *hitObj;
+			ofColor color = traceRay(ray, hitObj);
+
+			storeBasePixel(i, j, color, hitObj);
 		}
 	}
+}
+
+// Same as renderTile, but moves the whole tile through the render stages together (see Wavefront.h)
+//
+void ofApp::renderTileWavefront(int x0, int y0, int x1, int y1) {
+	thread_local WavefrontRenderer renderer;
+	renderer.renderTile(this, x0, y0, x1, y1);
+}
+
+// A pixel is on an edge if its base color differs from a neighbor's by more than the threshold,
+// or a different object (or no object) was hit there.
+//
+bool ofApp::isEdgePixel(int i, int j) {
+	int index = bufferIndex(i, j);
+	float threshold = aaThreshold * 255;
+	int neighbors[4][2] = { { i - 1, j }, { i + 1, j }, { i, j - 1 }, { i, j + 1 } };
+	for (auto &n : neighbors) {
+		if (n[0] < 0 || n[0] >= imageWidth || n[1] < 0 || n[1] >= imageHeight) continue;
+		int other = bufferIndex(n[0], n[1]);
+		if (pixelObjects[other] != pixelObjects[index]) return true;
+		const ofColor &a = baseColors[index];
+		const ofColor &b = baseColors[other];
+		if (abs(a.r - b.r) > threshold || abs(a.g - b.g) > threshold || abs(a.b - b.b) > threshold) return true;
+	}
+	return false;
+}
+
+// Re-render the edge pixels of a tile with an aaGrid x aaGrid block of stratified, jittered samples
+// averaged together with the base sample. Returns how many pixels were refined.
+//
+int ofApp::refineTile(int x0, int y0, int x1, int y1) {
+	TRACE_SCOPE_ARGS("refine tile", "render", "\"x\":" + ofToString(x0) + ",\"y\":" + ofToString(y0));
+
+	int grid = aaGrid;
+	int refined = 0;
+	for (int i = x0; i < x1; i++) {
+		for (int j = y0; j < y1; j++) {
+			if (!isEdgePixel(i, j)) continue;
+
+			ofColor base = baseColors[bufferIndex(i, j)];
+			glm::vec3 sum = glm::vec3(base.r, base.g, base.b);
+			for (int a = 0; a < grid; a++) {
+				for (int b = 0; b < grid; b++) {
+					uint32_t seed = ((j * imageWidth + i) * grid + a) * grid + b;
+					float du = (a + hashToUnit(seed * 2)) / grid;
+					float dv = (b + hashToUnit(seed * 2 + 1)) / grid;
+					SceneObject *hitObj;
+					ofColor c = traceRay(renderCam.getRay((i + du) / imageWidth, (j + dv) / imageHeight), hitObj);
+					sum += glm::vec3(c.r, c.g, c.b);
+				}
+			}
+			sum /= (float)(grid * grid + 1);
+			setCropColor(i, j, ofColor(sum.x, sum.y, sum.z));
+			refined++;
+		}
+	}
+	return refined;
+}
+
+// Apply a shiny Blinn-Phong shader effect to a color, given the point on the scene object, the normal, the unshaded color (diffuse), the highlight color (specular), and the strength of the effect
+// This includes the matte Lambert term, so each light only needs one shadow ray for both.
+//
+ofColor ofApp::phong(const glm::vec3 &p, const glm::vec3 &norm, const ofColor diffuse, const ofColor specular, float power) {
+	ofColor result = diffuse * (ambientStrength);	// ambient light level
+
+	thread_local vector<LightSample> samples;
+	samples.clear();
+	sampleLights(p, norm, diffuse, specular, power, samples);
+
+	glm::vec3 sum = glm::vec3(0, 0, 0);
+	for (LightSample &s : samples) {
+		if (!castShadows || !s.light->light->isBlocked(p + (norm * 0.01), scene)) sum += s.color;
+	}
+	result += ofColor(min(sum.x, 255.0f), min(sum.y, 255.0f), min(sum.z, 255.0f));
 	return result;
 }
 
+// Work out which lights need a shadow ray from point p, and what each one adds to the color if it isn't blocked
+//
+void ofApp::sampleLights(const glm::vec3 &p, const glm::vec3 &norm, const ofColor diffuse, const ofColor specular, float power, vector<LightSample> &samples) {
+	thread_local vector<const LightInfo *> candidates;		// lights whose beam reaches p
+	candidates.clear();
+	lightCuller.gather(p, candidates);
+	weighLights(candidates, p, norm, diffuse, specular, power, samples);
+}
+
+// The second half of sampleLights, given the lights that may reach p
+//
+void ofApp::weighLights(const vector<const LightInfo *> &candidates, const glm::vec3 &p, const glm::vec3 &norm, const ofColor diffuse, const ofColor specular, float power, vector<LightSample> &samples) {
+	float diffuseMax = max(diffuse.r, max(diffuse.g, diffuse.b));
+	float specularMax = max(specular.r, max(specular.g, specular.b));
+	for (const LightInfo *l : candidates) {
+		float lambertTerm = max((float)0, glm::dot(norm, glm::normalize(l->position - p)));
+		float phongTerm = glm::pow(max((float)0, glm::dot(norm, glm::normalize(l->position - p + eyePosition - p))), power);
+
+		// colors are stored as bytes, so a contribution under 1 in every channel is exactly zero; skip the shadow ray
+		if (diffuseMax * l->power * lambertTerm < 1 && specularMax * l->power * phongTerm < 1) continue;
+		ofColor c = diffuse * (l->power * lambertTerm);
+		c += specular * (l->power * phongTerm);
+		samples.push_back({ l, glm::vec3(c.r, c.g, c.b) });
+	}
+
+	int kept = samples.size();
+	if (!lightImportance || kept <= lightSamples) return;
+
+	// Too many lights: only cast shadow rays toward a few of them, picked in proportion to how much they would add,
+	// and scale each one up by 1 / (samples * probability) so the expected result is unchanged
+	thread_local vector<LightSample> all;
+	thread_local vector<float> cdf;
+	all.swap(samples);
+	samples.clear();
+	cdf.resize(kept);
+	float total = 0;
+	for (int i = 0; i < kept; i++) {
+		total += all[i].color.x + all[i].color.y + all[i].color.z;
+		cdf[i] = total;
+	}
+
+	int count = lightSamples;
+	uint32_t seed = hashPoint(p);
+	for (int s = 0; s < count; s++) {
+		float target = hashToUnit(seed + s * 0x9e3779b9) * total;
+		int i = std::lower_bound(cdf.begin(), cdf.end(), target) - cdf.begin();
+		i = min(i, kept - 1);
+		glm::vec3 c = all[i].color;
+		samples.push_back({ all[i].light, c * (total / ((c.x + c.y + c.z) * count)) });
+	}
+}
+
 
 //--------------------------------------------------------------
 void ofApp::setup() {
+	image.setUseTexture(!bHeadless);
 	image.allocate(imageWidth, imageHeight, OF_IMAGE_COLOR);
+	renderThreads = max(1, (int)std::thread::hardware_concurrency());
+	Tracer::setThreadName("main");
 	
 	mainCam.setDistance(30);
 	mainCam.lookAt(glm::vec3(0, 0, 0));
@@ -109,13 +623,17 @@ void ofApp::setup() {
 	theCam = &mainCam;
 
 	ofSetBackgroundColor(ofColor::black);
+	loader.start(max(1, (int)std::thread::hardware_concurrency() - 1));		// leave a core for the window
+	writer.start();
 
 	Plane *floorPlane = new Plane(glm::vec3(0, -1, 0), glm::vec3(0, 1, 0), 20, 20);
 	floorPlane->bInfinite = true;
-	floorPlane->setTexture(ofImage("07_wood grain PBR texture _seamless/07_wood grain PBR texture.jpg"));
 	Plane *backdropPlane = new Plane(glm::vec3(0, 5, -32), glm::vec3(0, 0, 1), 20, 20);
 	backdropPlane->bInfinite = true;
-	backdropPlane->setTexture(ofImage("2_Wallpaper PBR texture_seamless/2_Wallpaper PBR texture_seamless_DIFFUSE.jpg"));
+	if (!bHeadless) {		// the headless modes replace this scene, so its textures would only be decoded to be thrown away
+		loadTextureAsync("07_wood grain PBR texture _seamless/07_wood grain PBR texture.jpg", floorPlane, false);
+		loadTextureAsync("2_Wallpaper PBR texture_seamless/2_Wallpaper PBR texture_seamless_DIFFUSE.jpg", backdropPlane, false);
+	}
 	//Plane *picturePlane = new Plane(glm::vec3(-7, 4.5, -12), glm::vec3(0.6, 0.2, 1), ofColor::grey);
 	//picturePlane->width = 7.6;
 	//picturePlane->height = 4.8;
@@ -138,18 +656,221 @@ void ofApp::setup() {
 	gui.add(lightFalloff.setup("Light Falloff", 1.0, 1.0, 10.0));
 	gui.add(phongPower.setup("Phong Power", 100, 1, 400));
 	gui.add(ambientStrength.setup("Ambient Light Level", 0.3, 0.0, 1.0));
+	gui.add(antiAlias.setup("Anti-Aliasing", true));
+	gui.add(aaThreshold.setup("AA Edge Threshold", 0.1, 0.01, 1.0));
+	gui.add(aaGrid.setup("AA Samples Per Side", 3, 2, 8));
+	gui.add(lightImportance.setup("Importance Light Sampling", false));
+	gui.add(lightSamples.setup("Light Samples", 4, 1, 32));
+	gui.add(wavefront.setup("Wavefront Rendering", false));
+	gui.add(specializedKernels.setup("Specialized Kernels", true));
+	gui.add(sortShadowRays.setup("Sort Shadow Rays (wavefront)", true));
+	gui.add(previewBudget.setup("Preview Budget (s)", 2, 0.5, 30));
+	gui.add(viewportDivisor.setup("Viewport Pixel Size", 8, 1, 32));
+	gui.add(outOfCoreThreshold.setup("Out-of-Core Meshes Above (MB)", 256, 1, 4096));
+	gui.add(meshCacheBudget.setup("Mesh Cache Budget (MB)", 512, 16, 16384));
+	gui.add(detailScale.setup("Detail Resolution Scale", 2, 1, 8));
+	gui.add(lodError.setup("LOD Error (pixels)", 1.0, 0.0, 8.0));
+	gui.add(renderPort.setup("Render Port", 9240, 1024, 65535));
+	gui.add(localWorkers.setup("Local Workers", 2, 0, 16));
+	gui.add(animationFrames.setup("Animation Frames", 48, 2, 1000));
+	gui.add(outputFile.setup("Output File", "raytraced.png"));
+	gui.add(numberOutputs.setup("Number Output Files", false));
+	gui.add(pngCompression.setup("PNG Compression", 6, 0, 9));
+	gui.add(largeScale.setup("Large Render Scale", 4, 1, 32));
+	gui.add(memoryLabel.setup("Memory", ""));
 
 	display = &gui;
-
-}
+
+	if (bHeadless && !workerAddress.empty()) {		// started with --worker: render tiles for the coordinator and quit
+		ofExit(runWorker(this, workerAddress) ? 0 : 1);
+	}
+	else if (bHeadless && servePort) {		// started with --serve: take render jobs until stopped
+		RenderServer server;
+		ofExit(server.run(this, servePort) ? 0 : 1);
+	}
+	else if (bHeadless) {		// started with --regress or --record-golden: run the golden image check and quit
+		RegressionHarness harness;
+		harness.record = bRecordGolden;
+		ofExit(harness.run(this) ? 0 : 1);
+	}
+}
+
+// Parse an .obj file on a loader thread, then add it to the scene at pos and select it. Files bigger than the
+// out-of-core threshold are converted to chunks on disk instead of being read into memory.
+//
+void ofApp::loadMeshAsync(string fileName, glm::vec3 pos) {
+	SceneObject *obj;
+	std::function<bool()> work;
+	if (ofFile(fileName).getSize() > (uint64_t)outOfCoreThreshold * 1024 * 1024) {	// too big to hold in memory; keep it on disk
+		OutOfCoreMesh *chunked = new OutOfCoreMesh(pos);
+		work = [chunked, fileName]() { return chunked->build(fileName); };
+		obj = chunked;
+	}
+	else {
+		Mesh *mesh = new Mesh(pos);
+		work = [mesh, fileName]() {
+			mesh->readObjFile(fileName);
+			return mesh->getNumVertices() > 0;
+		};
+		obj = mesh;
+	}
+
+	loader.add(fileName, pos - glm::vec3(1, 1, 1), pos + glm::vec3(1, 1, 1), work, [this, obj](bool succeeded) {
+		if (!succeeded) {
+			delete obj;
+			return;
+		}
+		scene.push_back(obj);
+		display = &obj->settings;
+		selected.clear();
+		selected.push_back(obj);
+	});
+}
+
+// Decode an image and build its mip chain on a loader thread, then put it on plane, adding the plane to the scene
+// if addPlane is set. Without a window there is no GL context, so no texture is made for the image.
+//
+void ofApp::loadTextureAsync(string fileName, Plane *plane, bool addPlane) {
+	struct Prepared {
+		ofImage image;
+		shared_ptr<MipTexture> mip = make_shared<MipTexture>();
+	};
+	shared_ptr<Prepared> prepared = make_shared<Prepared>();
+
+	glm::vec3 lo, hi;
+	if (!plane->getBounds(lo, hi)) lo = hi = plane->position;		// infinite planes get no placeholder
+	loader.add(fileName, lo, hi, [prepared, fileName]() {
+		prepared->image.setUseTexture(false);		// GL calls have to stay on the main thread
+		if (!prepared->image.load(fileName)) return false;
+		prepared->mip->build(prepared->image);
+		return true;
+	}, [this, prepared, plane, addPlane](bool succeeded) {
+		if (succeeded) {
+			prepared->image.setUseTexture(!bHeadless);
+			prepared->image.update();
+			plane->setTexture(prepared->image, prepared->mip);
+		}
+		if (addPlane && succeeded) scene.push_back(plane);
+		else if (addPlane) delete plane;
+	});
+}
 
 //--------------------------------------------------------------
-void ofApp::update() {
+void ofApp::update() {
+	loader.collect();
+	if (bViewport) viewport.update(this, *theCam, ofGetWindowWidth() / viewportDivisor, ofGetWindowHeight() / viewportDivisor);
+
+	size_t sceneBytes, accelBytes, bufferBytes;
+	memoryUsage(sceneBytes, accelBytes, bufferBytes);
+	memoryLabel = formatBytes(sceneBytes) + " scene, " + formatBytes(accelBytes + bufferBytes) + " render";
+}
+
+// Heap memory held by the scene objects (meshes and textures), the structures built for rendering,
+// and the per-pixel buffers of the last render and the viewport
+//
+void ofApp::memoryUsage(size_t &sceneBytes, size_t &accelBytes, size_t &bufferBytes) {
+	sceneBytes = 0;
+	for (SceneObject *obj : scene) sceneBytes += obj->getMemoryUsage();
+	accelBytes = lightCuller.getMemoryUsage() + sceneLists.getMemoryUsage();
+	bufferBytes = image.getPixels().getTotalBytes() + baseColors.capacity() * sizeof(ofColor)
+		+ pixelObjects.capacity() * sizeof(SceneObject *) + viewport.getMemoryUsage();
+}
 
-}
+// Hash of every object in the scene and the global settings that change shading, so it changes whenever a render
+// of the scene would come out different
+//
+uint64_t ofApp::sceneSignature() {
+	uint64_t h = 14695981039346656037ull;
+	for (SceneObject *obj : scene) {
+		hashValue(h, obj);
+		hashValue(h, obj->getSignature());
+	}
+	hashValue(h, (float)lightFalloff);
+	hashValue(h, (float)phongPower);
+	hashValue(h, (float)ambientStrength);
+	hashValue(h, (bool)lightImportance);
+	hashValue(h, (int)lightSamples);
+	hashValue(h, (float)lodError);
+	return h;
+}
+
+// sceneSignature() plus where the render camera is and what it sees
+//
+uint64_t ofApp::renderViewSignature() {
+	uint64_t h = sceneSignature();
+	hashValue(h, renderCam.position);
+	hashValue(h, renderCam.aim);
+	hashValue(h, renderCam.view.position);
+	hashValue(h, renderCam.view.min);
+	hashValue(h, renderCam.view.max);
+	return h;
+}
+
+// Nearest selectable object along ray. Objects are tested in the order the ray enters their bounding boxes, and the
+// search stops once the closest hit so far is nearer than the next box. Objects without bounds are tested first.
+//
+SceneObject *ofApp::pickObject(const Ray &ray) {
+	TRACE_SCOPE("pickObject", "ui");
+	vector<pair<float, SceneObject *>> candidates;
+	for (SceneObject *obj : scene) {
+		if (!obj->isSelectable) continue;
+		glm::vec3 lo, hi;
+		float entry = 0;
+		if (obj->getBounds(lo, hi) && !rayBoxEntry(ray, lo, hi, entry)) continue;
+		candidates.push_back(make_pair(entry, obj));
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	SceneObject *nearest = NULL;
+	float nearestDist = std::numeric_limits<float>::infinity();
+	for (auto &c : candidates) {
+		if (c.first > nearestDist) break;
+		glm::vec3 point, norm;
+		Mesh *mesh = dynamic_cast<Mesh *>(c.second);		// the level of detail belongs to the last render, not to picking
+		if (mesh ? !mesh->intersectLevel(ray, point, norm, 0) : !c.second->intersect(ray, point, norm)) continue;
+		float dist = glm::length(point - ray.p);
+		if (dist < nearestDist) {
+			nearestDist = dist;
+			nearest = c.second;
+		}
+	}
+	return nearest;
+}
+
+// Where a ray crosses the render camera's view plane, as (u, v) in [0, 1); false if it misses
+//
+bool ofApp::viewPlaneAt(const Ray &ray, float &u, float &v) {
+	if (ray.d.z == 0) return false;
+	float t = (renderCam.view.position.z - ray.p.z) / ray.d.z;		// the view plane faces down the z axis
+	if (t <= 0) return false;
+	glm::vec3 onPlane = ray.p + ray.d * t;
+	u = (onPlane.x - renderCam.view.min.x) / renderCam.view.width();
+	v = (onPlane.y - renderCam.view.min.y) / renderCam.view.height();
+	return u >= 0 && u < 1 && v >= 0 && v < 1;
+}
+
+// Answer a pick through the render camera from the object IDs of the last render, if it's still current: find the
+// pixel the ray passes through on the view plane and return the object its center ray hit. Returns false when the
+// buffer can't answer, so the caller should trace the ray instead.
+//
+bool ofApp::pickFromObjectBuffer(const Ray &ray, SceneObject *&obj) {
+	if (theCam != &previewCam || objectBufferStamp == 0 || objectBufferStamp != renderViewSignature()) return false;
+	float u, v;
+	if (!viewPlaneAt(ray, u, v)) return false;
+
+	int i = u * objectBufferWidth;
+	int j = v * objectBufferHeight;
+	obj = pixelObjects[j * objectBufferWidth + i];
+	return !obj || obj->isSelectable;
+}
 
 //--------------------------------------------------------------
 void ofApp::draw() {
+	if (bViewport) {		// ray-traced view behind everything, with only the selection drawn over it
+		ofSetColor(ofColor::white);
+		viewport.draw(ofGetWindowWidth(), ofGetWindowHeight());
+	}
+
 	theCam->begin();
 
 	drawAxis(glm::vec3(0, 0, 0));
@@ -160,11 +881,12 @@ void ofApp::draw() {
 			obj->draw();
 			ofSetColor(ofColor::white);
 		}
-		else obj->draw();
+		else if (!bViewport) obj->draw();
 	}
 
 	ofDrawSphere(renderCam.position, 0.5);
 	renderCam.drawFrustum();
+	loader.drawPlaceholders();
 
 	theCam->end();
 
@@ -216,10 +938,19 @@ void ofApp::keyPressed(int key) {
 			vector<Light *>::iterator l = lights.begin();	// make sure it gets deleted if it's a light source
 			while (*l != deadObj && l != lights.end()) l++;		
 			if (*l == deadObj) lights.erase(l);
+			animation.forget(deadObj);
 		}
 		selected.clear();
 		display = &gui;
-		break;
+		break;
+	case 'G':
+	case 'g':		// check the renderer against the golden images
+	{
+		RegressionHarness harness;
+		harness.run(this);
+		bShowImage = false;
+		break;
+	}
 	case 'K':
 	case 'k':		// add a new spotlight
 		lights.push_back(new Spotlight(glm::vec3(0, 0, 0), 1.5, glm::vec3(0, -1, 0), 10));
@@ -250,6 +981,43 @@ void ofApp::keyPressed(int key) {
 	case 'r':		// render image
 		rayTrace();
 		break;
+	case 'W':
+	case 'w':		// toggle the ray-traced viewport
+		bViewport = !bViewport;
+		break;
+	case 'X':
+	case 'x':		// render a close-up of part of the frame
+		renderDetail();
+		break;
+	case 'N':
+	case 'n':		// render the frame on worker processes
+		renderDistributed();
+		break;
+	case 'J':
+	case 'j':		// render the frame on a render server on this machine
+		renderOnServer();
+		break;
+	case 'B':
+	case 'b':		// render a big frame straight to disk
+		renderLarge();
+		break;
+	case 'F':
+	case 'f':		// add an animation keyframe of the render camera and every object
+		animation.addKeyframe(this);
+		break;
+	case 'E':
+	case 'e':		// erase the animation keyframes
+		animation.clear();
+		cout << "keyframes cleared" << endl;
+		break;
+	case 'A':
+	case 'a':		// render the animation through the keyframes
+		if (animation.render(this, animationFrames, antiAlias, "frames")) bShowImage = true;
+		break;
+	case 'V':
+	case 'v':		// render the best preview that fits in the time budget
+		previewRender(previewBudget);
+		break;
 	case 'S':
 	case 's':		// add a sphere to the scene
 		scene.push_back(new Sphere(glm::vec3(0, 0, 0), 1.5));
@@ -258,6 +1026,14 @@ void ofApp::keyPressed(int key) {
 		selected.clear();
 		selected.push_back(scene.back());
 		break;
+	case 'T':
+	case 't':		// start recording a timeline trace, or stop and save it
+		if (Tracer::isEnabled()) {
+			Tracer::stop();
+			Tracer::save("trace.json");
+		}
+		else Tracer::start();
+		break;
 	case ' ':		// toggle image overlay
 		bShowImage = !bShowImage;
 		break;
@@ -331,41 +1107,15 @@ void ofApp::mousePressed(int x, int y, int button) {
 	//
 	// test if something selected
 	//
-	vector<SceneObject *> hits;
-	vector<glm::vec3> pts;
-
 	glm::vec3 p = theCam->screenToWorld(glm::vec3(x, y, 0));
 	glm::vec3 d = p - theCam->getPosition();
 	glm::vec3 dn = glm::normalize(d);
 
-	// check for selection of scene objects
-	//
-	for (int i = 0; i < scene.size(); i++) {
-
-		glm::vec3 point, norm;
-
-		//  We hit an object
-		//
-		if (scene[i]->isSelectable && scene[i]->intersect(Ray(p, dn), point, norm)) {
-			hits.push_back(scene[i]);
-			pts.push_back(point);
-		}
-	}
-
-	// if we selected more than one, pick nearest
+	// look the pixel up in the last render if we're seeing through the render camera, otherwise find the nearest
+	// object along the ray
 	//
 	SceneObject *selectedObj = NULL;
-	if (hits.size() > 0) {
-		selectedObj = hits[0];
-		float nearestDist = std::numeric_limits<float>::infinity();
-		for (int n = 0; n < hits.size(); n++) {
-			float dist = glm::length(pts[n] - theCam->getPosition());
-			if (dist < nearestDist) {
-				nearestDist = dist;
-				selectedObj = hits[n];
-			}
-		}
-	}
+	if (!pickFromObjectBuffer(Ray(p, dn), selectedObj)) selectedObj = pickObject(Ray(p, dn));
 	if (selectedObj) {
 		selected.push_back(selectedObj);
 		bDrag = true;
@@ -406,12 +1156,18 @@ void ofApp::gotMessage(ofMessage msg) {
 
 //--------------------------------------------------------------
 void ofApp::dragEvent(ofDragInfo dragInfo) {
-	Mesh *mesh = new Mesh(glm::vec3(0, 1, 0));
-	mesh->readObjFile(dragInfo.files[0]);
-	scene.push_back(mesh);
-	display = &mesh->settings;
+	int meshes = 0, planes = 0;
+	for (string &file : dragInfo.files) {
+		string ext = ofToLower(ofFilePath::getFileExt(file));
+		if (ext == "obj") loadMeshAsync(file, glm::vec3(3 * meshes++, 1, 0));		// side by side, so they don't overlap
+		else if (ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp" || ext == "tga" || ext == "tif" || ext == "tiff") {
+			Plane *selectedPlane = objSelected() ? dynamic_cast<Plane *>(selected[0]) : NULL;
+			if (selectedPlane && planes == 0) loadTextureAsync(file, selectedPlane, false);
+			else loadTextureAsync(file, new Plane(glm::vec3(0, 0, -6 * planes), glm::vec3(0, 1, 0)), true);
+			planes++;
+		}
+		else cout << "can't load " << file << ": only .obj meshes and images can be dropped" << endl;
+	}
+}
 
-	selected.clear();
-	selected.push_back(mesh);
-}
 
@@ -12,8 +12,21 @@
 
 #include "ofMain.h"
 #include "Mesh.h"
+#include "OutOfCoreMesh.h"
 #include "Shapes.h"
 #include "Lights.h"
+#include "LightCuller.h"
+#include "Wavefront.h"
+#include "Viewport.h"
+#include "Tracer.h"
+#include "Kernels.h"
+#include "Regression.h"
+#include "AssetLoader.h"
+#include "Distributed.h"
+#include "RenderServer.h"
+#include "Animation.h"
+#include "ImageWriter.h"
+#include "RenderPool.h"
 
 
 // view plane for render camera
@@ -102,16 +115,50 @@ class ofApp : public ofBaseApp{
 		void dragEvent(ofDragInfo dragInfo);
 		void gotMessage(ofMessage msg);
 		void rayTrace();
+		bool renderImage(bool aa, bool shadows);
+		bool renderRegion(int width, int height, int x, int y, int w, int h, ofPixels &pixels, bool aa, bool shadows);
+		bool renderCrop(int x, int y, int w, int h, bool aa, bool shadows);
+		void renderDetail();
+		void renderDistributed();
+		void renderOnServer();
+		void renderLarge();
+		string nextOutputFile();
+		void saveOutput();
+		void previewRender(float budgetSeconds, bool save = true);
+		uint64_t sceneSignature();
+		uint64_t renderViewSignature();
+		SceneObject *pickObject(const Ray &ray);
+		bool pickFromObjectBuffer(const Ray &ray, SceneObject *&obj);
+		bool viewPlaneAt(const Ray &ray, float &u, float &v);
+		void memoryUsage(size_t &sceneBytes, size_t &accelBytes, size_t &bufferBytes);
+		void prepareRender(glm::vec3 eye, float pixelAngle, bool shadows);
+		bool forEachTile(int width, int height, string passName, std::function<void(int, int, int, int)> tileFunc);
+		void renderTile(int x0, int y0, int x1, int y1);
+		void renderTileWavefront(int x0, int y0, int x1, int y1);
+		int refineTile(int x0, int y0, int x1, int y1);
+		bool isEdgePixel(int i, int j);
+		ofColor traceRay(const Ray &ray, SceneObject *&hitObj);
+		ofColor shadeHit(const Ray &ray, const HitRecord &hit);
+		bool closestHit(const Ray &ray, HitRecord &hit);
+		float pixelFootprint(const Ray &ray, const HitRecord &hit);
+		void loadMeshAsync(string fileName, glm::vec3 pos);
+		void loadTextureAsync(string fileName, Plane *plane, bool addPlane);
 		void drawGrid() { ofDrawGrid(); }
 		void drawAxis(glm::vec3);
 		bool mouseToDragPlane(int x, int y, glm::vec3 &point);
 		bool objSelected() { return (selected.size() ? true : false); };
-		ofColor lambert(const glm::vec3&, const glm::vec3&, ofColor);
 		ofColor phong(const glm::vec3&, const glm::vec3&, const ofColor, const ofColor, float);
+		void sampleLights(const glm::vec3&, const glm::vec3&, const ofColor, const ofColor, float, vector<LightSample> &);
+		void weighLights(const vector<const LightInfo *> &, const glm::vec3&, const glm::vec3&, const ofColor, const ofColor, float, vector<LightSample> &);
 
 		bool bDrag = false;
 		bool bHide = true;
 		bool bShowImage = false;
+		bool bViewport = false;		// show the ray-traced viewport instead of wireframes
+		bool bHeadless = false;		// running without a window to do the regression check or as a worker (see main.cpp)
+		bool bRecordGolden = false;	// started with --record-golden
+		string workerAddress;		// coordinator to render tiles for, if started as a worker
+		int servePort = 0;			// port to take render jobs on, if started as a render server
 
 		ofEasyCam  mainCam;
 		ofCamera sideCam;
@@ -122,21 +169,84 @@ class ofApp : public ofBaseApp{
 		//
 		RenderCam renderCam;
 		ofImage image;
+		Viewport viewport;
 
 		vector<SceneObject *> scene;
 		vector<SceneObject *> selected;
 		vector<Light *> lights;
+		LightCuller lightCuller;
+		SceneLists sceneLists;		// the scene split by type, and the kernels chosen for it, for the current render
+		RenderKernels kernels;
 
 		ofxFloatSlider lightFalloff;
 		ofxFloatSlider phongPower;
 		ofxFloatSlider ambientStrength;
+		ofxToggle antiAlias;
+		ofxFloatSlider aaThreshold;
+		ofxIntSlider aaGrid;
+		ofxToggle lightImportance;
+		ofxIntSlider lightSamples;
+		ofxToggle wavefront;
+		ofxToggle specializedKernels;
+		ofxToggle sortShadowRays;
+		ofxFloatSlider previewBudget;
+		ofxIntSlider viewportDivisor;
+		ofxIntSlider outOfCoreThreshold;
+		ofxIntSlider meshCacheBudget;
+		ofxFloatSlider lodError;
+		ofxIntSlider detailScale;
+		ofxIntSlider renderPort;
+		ofxIntSlider localWorkers;
+		ofxIntSlider animationFrames;
+		ofxTextField outputFile;
+		ofxToggle numberOutputs;
+		ofxIntSlider pngCompression;
+		ofxIntSlider largeScale;
+		ofxLabel memoryLabel;
 		ofxPanel gui;
 
 		ofxPanel *display;
 
 		int imageWidth = 1200;
 		int imageHeight = 800;
+		int tileSize = 32;			// width and height of the square blocks the image is split into for the render threads
+		int renderThreads = 1;
+		glm::vec3 eyePosition;		// camera position for the current render, for specular highlights
+		float pixelAngle = 0;		// angle covered by one image pixel, for texture filtering
+		bool castShadows = true;
+		bool printProgress = true;
+		bool bDeadline = false;		// stop handing out tiles after renderDeadline
+		std::chrono::steady_clock::time_point renderDeadline;
+
+		// the part of the frame being rendered, in frame pixels with j counting up from the bottom: image holds just
+		// the crop, the base pass buffers also a one pixel border around it
+		int cropX0 = 0, cropY0 = 0, cropX1 = 0, cropY1 = 0;
+		int bufX0 = 0, bufY0 = 0, bufWidth = 0, bufHeight = 0;
+
+		// per-pixel results of the base pass, indexed by bufferIndex(i, j), used to find edges to anti-alias
+		vector<ofColor> baseColors;
+		vector<SceneObject *> pixelObjects;
+
+		int bufferIndex(int i, int j) { return (j - bufY0) * bufWidth + (i - bufX0); }
+		void setCropColor(int i, int j, const ofColor &color) {
+			if (i >= cropX0 && i < cropX1 && j >= cropY0 && j < cropY1) image.setColor(i - cropX0, cropY1 - 1 - j, color);
+		}
+		void storeBasePixel(int i, int j, const ofColor &color, SceneObject *obj) {
+			baseColors[bufferIndex(i, j)] = color;
+			pixelObjects[bufferIndex(i, j)] = obj;
+			setCropColor(i, j, color);
+		}
+
+		// which render pixelObjects belongs to, so picking can use it while the scene and render camera are unchanged
+		uint64_t objectBufferStamp = 0;		// renderViewSignature() of the last finished base pass, 0 if none
+		int objectBufferWidth = 0, objectBufferHeight = 0;
 
 		glm::vec3 lastPoint;
+		Animation animation;
+		int outputCount = 0;		// last number used for a numbered output file
+
+		ImageWriter writer;
+		RenderPool renderPool;
+		AssetLoader loader;		// last, so its threads are joined before anything else is destroyed
 };
  
\ No newline at end of file